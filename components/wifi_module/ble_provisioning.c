@@ -3,6 +3,8 @@
 
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_bt.h"
 #include "host/ble_att.h"
 #include "host/ble_hs.h"
 #include "host/ble_hs_mbuf.h"
@@ -14,18 +16,68 @@
 #include "ble_provisioning.h"
 #include "wifi_module.h"
 #include "utilities.h"
+#include "prov_worker.h"
+#include "prov_tlv.h"
+#include "boot_trace.h"
+#include "dlog.h"
 
 static const char *TAG = "BLE_VISION";
-static char ble_ssid[32];
-static char ble_pass[64];
+static char ble_ssid[33];
+static char ble_pass[65];
+static bool ble_ssid_written = false;
+static bool ble_pass_written = false;
 static uint8_t ble_addr_type;
 static bool ble_shutdown_requested = false;
-
-static void ble_app_advertise(void);
+static bool ble_running = false;
+static bool ble_mem_released = false;
+
+typedef enum {
+    ADV_PHASE_OFF,
+    ADV_PHASE_FAST,
+    ADV_PHASE_SLOW,
+} adv_phase_t;
+
+static const char *adv_phase_names[] = { "off", "fast", "slow" };
+static adv_phase_t s_adv_phase = ADV_PHASE_OFF;
+static int64_t s_adv_phase_start_us = 0;
+static int64_t s_adv_cycle_start_us = 0;     // start of the fast burst, for discovery latency
+static int64_t s_adv_phase_total_us[3];
+
+// Status characteristic: {state, reason, ip[4]}
+typedef struct {
+    uint8_t state;
+    uint8_t reason;
+    uint8_t ip[4];
+} ble_status_value_t;
+
+static uint16_t s_status_val_handle;
+static ble_status_value_t s_status_value;
+static ble_status_value_t s_status_queue[BLE_PROV_STATUS_QUEUE_LEN];
+static uint8_t s_status_head = 0;
+static uint8_t s_status_count = 0;
+static portMUX_TYPE s_status_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct ble_npl_event s_status_event;
+static volatile bool s_status_event_ready = false;
+
+// Host-task state of the subscribed client
+static uint16_t s_status_conn = BLE_HS_CONN_HANDLE_NONE;
+static bool s_status_notify = false;
+static bool s_status_indicate = false;
+static bool s_indication_pending = false;
+
+// ATT traffic of the current connection, logged on disconnect
+static uint16_t s_session_writes = 0;
+static uint16_t s_session_reads = 0;
+static uint16_t s_session_pushes = 0;
+
+static void ble_app_advertise(adv_phase_t phase);
+static void adv_phase_end(void);
 static void nimble_host_task(void *param);
 static int ble_gap_event(struct ble_gap_event *event, void *arg);
 static int gatt_copy_value(char *dst, size_t dst_len, struct ble_gatt_access_ctxt *ctxt);
+static int gatt_write_credentials(struct ble_gatt_access_ctxt *ctxt);
 static int gatt_svr_access_wifi(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+static int gatt_svr_access_status(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
 
 static const ble_uuid128_t gatt_svr_svc_uuid =
     BLE_UUID128_INIT(0x2d, 0x71, 0xa1, 0x20, 0x53, 0x75, 0x49, 0x73,
@@ -37,6 +89,12 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
         .uuid = &gatt_svr_svc_uuid.u,
         .characteristics = (struct ble_gatt_chr_def[]) { 
             {
+                // Whole credential set in one (long) write, see prov_tlv.h
+                .uuid = BLE_UUID16_DECLARE(GATT_WIFI_CRED_UUID),
+                .access_cb = gatt_svr_access_wifi,
+                .flags = BLE_GATT_CHR_F_WRITE,
+            }, {
+                // Legacy two-write interface, kept for existing clients
                 .uuid = BLE_UUID16_DECLARE(GATT_WIFI_SSID_UUID),
                 .access_cb = gatt_svr_access_wifi,
                 .flags = BLE_GATT_CHR_F_WRITE,
@@ -44,6 +102,12 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
                 .uuid = BLE_UUID16_DECLARE(GATT_WIFI_PASS_UUID),
                 .access_cb = gatt_svr_access_wifi,
                 .flags = BLE_GATT_CHR_F_WRITE,
+            }, {
+                // Subscribe once and the outcome is pushed, no polling or reconnecting
+                .uuid = BLE_UUID16_DECLARE(GATT_WIFI_STATUS_UUID),
+                .access_cb = gatt_svr_access_status,
+                .val_handle = &s_status_val_handle,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE,
             }, {
                 0, //No More Characterstics
             }
@@ -54,7 +118,7 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
     },
 };
 
-static int gatt_svr_access_wifi(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+static int handle_gatt_access(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
     (void)conn_handle;
     (void)attr_handle;
     (void)arg;
@@ -62,33 +126,165 @@ static int gatt_svr_access_wifi(uint16_t conn_handle, uint16_t attr_handle, stru
     uint16_t uuid = ble_uuid_u16(ctxt->chr->uuid);
 
     if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        s_session_writes++;
+        if (uuid == GATT_WIFI_CRED_UUID) {
+            return gatt_write_credentials(ctxt);
+        }
         if (uuid == GATT_WIFI_SSID_UUID) {
             int rc = gatt_copy_value(ble_ssid, sizeof(ble_ssid), ctxt);
             if (rc != 0) {
                 return rc;
             }
-            ESP_LOGI(TAG, "Received SSID via BLE: %s", ble_ssid);
+            ble_ssid_written = true;
+            dlog_str(DLOG_BLE_SSID, ble_ssid, 0, 0, 0, 0);
         }
         if (uuid == GATT_WIFI_PASS_UUID) {
             int rc = gatt_copy_value(ble_pass, sizeof(ble_pass), ctxt);
             if (rc != 0) {
                 return rc;
             }
-            ESP_LOGI(TAG, "Received PASS via BLE: %s", ble_pass);
-
-            if (strlen(ble_ssid) > 0 && strlen(ble_pass) > 0) {
-                ESP_LOGI(TAG, "Saving credentials received via BLE...");
-                save_wifi_credentials(ble_ssid, ble_pass); //save wifi_credentials to NVS
-                stop_provisioning_manager();
-                stop_ble_provisioning();
-                vTaskDelay(pdMS_TO_TICKS(1000));
-                esp_restart();
+            ble_pass_written = true;
+            dlog_str(DLOG_BLE_PASS, ble_pass, 0, 0, 0, 0);
+        }
+
+        // The pair is committed once both halves are in, whichever order they came in
+        if (ble_ssid_written && ble_pass_written) {
+            ble_ssid_written = false;
+            ble_pass_written = false;
+            // Saving, applying and BLE teardown happen on the provisioning worker, not the host task
+            dlog(DLOG_BLE_HANDOFF, 0, 0, 0, 0);
+            boot_trace_mark(TRACE_CREDS_RECEIVED, PROV_SOURCE_BLE);
+            if (prov_worker_post_credentials(PROV_SOURCE_BLE, ble_ssid, ble_pass, NULL) != ESP_OK) {
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
             }
         }
     }
     return 0;
 }
 
+static int gatt_svr_access_wifi(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+    int64_t start_us = esp_timer_get_time();
+    int rc = handle_gatt_access(conn_handle, attr_handle, ctxt, arg);
+    dlog_time_callback(DLOG_CB_GATT, start_us);
+    return rc;
+}
+
+// Combined characteristic: NimBLE reassembles prepared (long) writes, so ctxt->om holds the whole payload
+static int gatt_write_credentials(struct ble_gatt_access_ctxt *ctxt) {
+    static const char hex[] = "0123456789abcdef";
+    // Up to a full attribute: fields a newer client adds are skipped by the decoder, not refused here.
+    // Static to keep it off the host task's stack; access callbacks all run on that one task
+    static uint8_t buf[BLE_ATT_ATTR_MAX_LEN];
+    prov_tlv_creds_t creds;
+    uint16_t len = 0;
+
+    if (OS_MBUF_PKTLEN(ctxt->om) > sizeof(buf)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    prov_tlv_err_t err = prov_tlv_decode(buf, len, &creds);
+    memset(buf, 0, sizeof(buf));
+    if (err != PROV_TLV_OK) {
+        dlog(DLOG_BLE_TLV_REJECTED, len, err, 0, 0);
+        return err == PROV_TLV_ERR_VERSION ? BLE_ATT_ERR_REQ_NOT_SUPPORTED : BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    // A raw PSK travels as 64 hex digits, which the driver and storage already accept as-is
+    if (creds.has_psk) {
+        for (int i = 0; i < (int)sizeof(creds.psk); i++) {
+            creds.passphrase[i * 2] = hex[creds.psk[i] >> 4];
+            creds.passphrase[i * 2 + 1] = hex[creds.psk[i] & 0x0f];
+        }
+        creds.passphrase[sizeof(creds.psk) * 2] = '\0';
+    }
+
+    dlog_str(DLOG_BLE_CREDS, creds.ssid, len, 0, 0, 0);
+    boot_trace_mark(TRACE_CREDS_RECEIVED, PROV_SOURCE_BLE);
+    esp_err_t rc = prov_worker_post_credentials(PROV_SOURCE_BLE, creds.ssid, creds.passphrase,
+                                                creds.has_bssid ? creds.bssid : NULL);
+    memset(&creds, 0, sizeof(creds));
+    return rc == ESP_OK ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int gatt_svr_access_status(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+    (void)conn_handle;
+    (void)attr_handle;
+    (void)arg;
+    ble_status_value_t value;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    s_session_reads++;
+    portENTER_CRITICAL(&s_status_lock);
+    value = s_status_value;
+    portEXIT_CRITICAL(&s_status_lock);
+    return os_mbuf_append(ctxt->om, &value, sizeof(value)) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+// Runs on the NimBLE host task: drain queued transitions to the subscribed client
+static void status_event_cb(struct ble_npl_event *ev) {
+    (void)ev;
+    ble_status_value_t value;
+
+    while (!s_indication_pending) {
+        portENTER_CRITICAL(&s_status_lock);
+        if (s_status_count == 0) {
+            portEXIT_CRITICAL(&s_status_lock);
+            return;
+        }
+        value = s_status_queue[s_status_head];
+        s_status_head = (s_status_head + 1) % BLE_PROV_STATUS_QUEUE_LEN;
+        s_status_count--;
+        portEXIT_CRITICAL(&s_status_lock);
+
+        if (s_status_conn == BLE_HS_CONN_HANDLE_NONE || (!s_status_notify && !s_status_indicate)) {
+            continue;
+        }
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(&value, sizeof(value));
+        if (om == NULL) {
+            dlog(DLOG_BLE_STATUS_NO_MBUF, value.state, 0, 0, 0);
+            continue;
+        }
+        // Notifications if the client takes them; indications go one at a time until confirmed
+        int rc;
+        if (s_status_notify) {
+            rc = ble_gatts_notify_custom(s_status_conn, s_status_val_handle, om);
+        } else {
+            rc = ble_gatts_indicate_custom(s_status_conn, s_status_val_handle, om);
+            s_indication_pending = (rc == 0);
+        }
+        if (rc == 0) {
+            s_session_pushes++;
+        } else {
+            dlog(DLOG_BLE_STATUS_FAILED, value.state, rc, 0, 0);
+        }
+    }
+}
+
+void ble_provisioning_notify_status(ble_prov_status_t status, uint8_t reason, uint32_t ip) {
+    ble_status_value_t value = { .state = (uint8_t)status, .reason = reason };
+    memcpy(value.ip, &ip, sizeof(value.ip));
+
+    portENTER_CRITICAL(&s_status_lock);
+    s_status_value = value;
+    if (s_status_count == BLE_PROV_STATUS_QUEUE_LEN) {
+        s_status_head = (s_status_head + 1) % BLE_PROV_STATUS_QUEUE_LEN;
+        s_status_count--;
+    }
+    s_status_queue[(s_status_head + s_status_count) % BLE_PROV_STATUS_QUEUE_LEN] = value;
+    s_status_count++;
+    portEXIT_CRITICAL(&s_status_lock);
+
+    // Only a wake-up for the host task; the queue above carries the data
+    if (s_status_event_ready) {
+        ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &s_status_event);
+    }
+}
+
 static int gatt_copy_value(char *dst, size_t dst_len, struct ble_gatt_access_ctxt *ctxt) {
     uint16_t len = 0;
     int rc;
@@ -125,18 +321,50 @@ static void ble_app_on_sync(void) {
         return;
     }
     if (!ble_shutdown_requested) {
-        ble_app_advertise();
+        ble_app_advertise(ADV_PHASE_FAST);
     }
 }
 
 
+void ble_provisioning_release_memory(void) {
+    if (ble_running || ble_mem_released) {
+        return;
+    }
+    esp_err_t err = esp_bt_controller_mem_release(ESP_BT_MODE_BTDM);
+    if (err == ESP_OK) {
+        ble_mem_released = true;
+        ESP_LOGI(TAG, "BT controller memory released");
+    } else {
+        ESP_LOGW(TAG, "BT controller memory release failed: %s", esp_err_to_name(err));
+    }
+}
+
 void start_ble_provisioning(void) {
+    if (ble_running) {
+        return;
+    }
+    if (ble_mem_released) {
+        ESP_LOGW(TAG, "BT controller memory was released, BLE provisioning unavailable until reboot");
+        return;
+    }
     ble_shutdown_requested = false;
     ESP_ERROR_CHECK(nimble_port_init());
+    ble_running = true;
 
     // Set the sync callback
     ble_hs_cfg.sync_cb = ble_app_on_sync;
 
+    // Ask for an MTU that fits a full credential payload in a single write, unless sdkconfig already asks for more
+    if (ble_att_preferred_mtu() < BLE_PROV_PREFERRED_MTU) {
+        int mtu_rc = ble_att_set_preferred_mtu(BLE_PROV_PREFERRED_MTU);
+        if (mtu_rc != 0) {
+            ESP_LOGW(TAG, "Could not set preferred MTU: %d", mtu_rc);
+        }
+    }
+
+    ble_npl_event_init(&s_status_event, status_event_cb, NULL);
+    s_status_event_ready = true;
+
     // Register GAP and GATT services
     ble_svc_gap_init();
     ble_svc_gatt_init();
@@ -152,27 +380,95 @@ void start_ble_provisioning(void) {
 
     // Start NimBLE task
     nimble_port_freertos_init(nimble_host_task);
+    boot_trace_mark(TRACE_BLE_STARTED, 0);
+    ESP_LOGI(TAG, "BLE provisioning started.");
 }
 
 void stop_ble_provisioning(void) {
+    if (!ble_running) {
+        return;
+    }
     ble_shutdown_requested = true;
-    nimble_port_stop();
+    s_status_event_ready = false;
     int rc = ble_gap_adv_stop();
     if (rc != 0) {
         ESP_LOGW(TAG, "BLE advertising stop returned: %d", rc);
     } else {
         ESP_LOGI(TAG, "BLE advertising stopped.");
     }
+
+    // Host task leaves nimble_port_run() and deletes itself; deinit also shuts the controller down
+    rc = nimble_port_stop();
+    if (rc == 0) {
+        nimble_port_deinit();
+    } else {
+        ESP_LOGW(TAG, "NimBLE stop failed: %d", rc);
+    }
+    ble_running = false;
+
+    // The controller's RAM stays reserved: the portal, and BLE with it, can reopen later in this boot
+    adv_phase_end();
+    ESP_LOGI(TAG, "Advertising time: fast %lld ms, slow %lld ms",
+             s_adv_phase_total_us[ADV_PHASE_FAST] / 1000, s_adv_phase_total_us[ADV_PHASE_SLOW] / 1000);
 }
 
 static int ble_gap_event(struct ble_gap_event *event, void *arg) {
     (void)arg;
 
     switch (event->type) {
+    case BLE_GAP_EVENT_CONNECT:
+        if (event->connect.status != 0) {
+            // Connection attempt failed; advertising stopped with it
+            adv_phase_end();
+            if (!ble_shutdown_requested) {
+                ble_app_advertise(ADV_PHASE_FAST);
+            }
+            return 0;
+        }
+        int64_t latency_ms = (esp_timer_get_time() - s_adv_cycle_start_us) / 1000;
+        boot_trace_mark(TRACE_BLE_CONNECTED, (uint32_t)latency_ms);
+        dlog_str(DLOG_BLE_CONNECTED, adv_phase_names[s_adv_phase], (uint32_t)latency_ms, 0, 0, 0);
+        adv_phase_end();
+        return 0;
+    case BLE_GAP_EVENT_MTU:
+        dlog(DLOG_BLE_MTU, event->mtu.value, 0, 0, 0);
+        return 0;
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        if (event->subscribe.attr_handle == s_status_val_handle) {
+            s_status_conn = event->subscribe.conn_handle;
+            s_status_notify = event->subscribe.cur_notify;
+            s_status_indicate = event->subscribe.cur_indicate;
+            dlog(DLOG_BLE_SUBSCRIBE, s_status_notify, s_status_indicate, 0, 0);
+        }
+        return 0;
+    case BLE_GAP_EVENT_NOTIFY_TX:
+        // Indication confirmed (BLE_HS_EDONE) or failed: the next queued status can go out
+        if (event->notify_tx.indication && event->notify_tx.status != 0) {
+            s_indication_pending = false;
+            ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &s_status_event);
+        }
+        return 0;
     case BLE_GAP_EVENT_DISCONNECT:
+        dlog(DLOG_BLE_DISCONNECT, s_session_writes, s_session_reads, s_session_pushes, 0);
+        s_session_writes = 0;
+        s_session_reads = 0;
+        s_session_pushes = 0;
+        s_status_conn = BLE_HS_CONN_HANDLE_NONE;
+        s_status_notify = false;
+        s_status_indicate = false;
+        s_indication_pending = false;
+        // Don't let half a legacy pair from one client complete another's
+        ble_ssid_written = false;
+        ble_pass_written = false;
+        if (!ble_shutdown_requested) {
+            ble_app_advertise(ADV_PHASE_FAST);
+        }
+        return 0;
     case BLE_GAP_EVENT_ADV_COMPLETE:
+        // The fast burst ran its duration without a connection
+        adv_phase_end();
         if (!ble_shutdown_requested) {
-            ble_app_advertise();
+            ble_app_advertise(ADV_PHASE_SLOW);
         }
         return 0;
     default:
@@ -180,25 +476,54 @@ static int ble_gap_event(struct ble_gap_event *event, void *arg) {
     }
 }
 
-static void ble_app_advertise(void) {
-    struct ble_gap_adv_params adv_params;
+static void adv_phase_end(void) {
+    if (s_adv_phase == ADV_PHASE_OFF) {
+        return;
+    }
+    int64_t spent_us = esp_timer_get_time() - s_adv_phase_start_us;
+    s_adv_phase_total_us[s_adv_phase] += spent_us;
+    dlog_str(DLOG_BLE_ADV_PHASE_END, adv_phase_names[s_adv_phase], (uint32_t)(spent_us / 1000), 0, 0, 0);
+    s_adv_phase = ADV_PHASE_OFF;
+}
+
+// Service UUID in the advertisement so scanners can filter on it; name goes in the scan response
+static int ble_app_set_adv_data(void) {
     struct ble_hs_adv_fields adv_fields;
+    struct ble_hs_adv_fields rsp_fields;
     int rc;
 
     memset(&adv_fields, 0, sizeof(adv_fields));
-
     adv_fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
-
-    adv_fields.appearance = 0x0080;
-    adv_fields.appearance_is_present = 1;
-
-    adv_fields.name = (uint8_t *)"ESP_BLE_VISION";
-    adv_fields.name_len = strlen("ESP_BLE_VISION");
-    adv_fields.name_is_complete = 1;
+    adv_fields.uuids128 = &gatt_svr_svc_uuid;
+    adv_fields.num_uuids128 = 1;
+    adv_fields.uuids128_is_complete = 1;
 
     rc = ble_gap_adv_set_fields(&adv_fields);
     if (rc != 0) {
         ESP_LOGE(TAG, "Error setting advertisement fields: %d", rc);
+        return rc;
+    }
+
+    memset(&rsp_fields, 0, sizeof(rsp_fields));
+    rsp_fields.appearance = 0x0080;
+    rsp_fields.appearance_is_present = 1;
+    rsp_fields.name = (uint8_t *)"ESP_BLE_VISION";
+    rsp_fields.name_len = strlen("ESP_BLE_VISION");
+    rsp_fields.name_is_complete = 1;
+
+    rc = ble_gap_adv_rsp_set_fields(&rsp_fields);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Error setting scan response fields: %d", rc);
+    }
+    return rc;
+}
+
+static void ble_app_advertise(adv_phase_t phase) {
+    struct ble_gap_adv_params adv_params;
+    int32_t duration_ms;
+    int rc;
+
+    if (ble_app_set_adv_data() != 0) {
         return;
     }
 
@@ -206,11 +531,28 @@ static void ble_app_advertise(void) {
     memset(&adv_params, 0, sizeof(adv_params));
     adv_params.conn_mode = BLE_GAP_CONN_MODE_UND; //Unidirected Connectable
     adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN; //General Discovery Mode
+    if (phase == ADV_PHASE_FAST) {
+        adv_params.itvl_min = BLE_GAP_ADV_ITVL_MS(BLE_ADV_FAST_ITVL_MIN_MS);
+        adv_params.itvl_max = BLE_GAP_ADV_ITVL_MS(BLE_ADV_FAST_ITVL_MAX_MS);
+        duration_ms = BLE_ADV_FAST_DURATION_MS;
+    } else {
+        adv_params.itvl_min = BLE_GAP_ADV_ITVL_MS(BLE_ADV_SLOW_ITVL_MIN_MS);
+        adv_params.itvl_max = BLE_GAP_ADV_ITVL_MS(BLE_ADV_SLOW_ITVL_MAX_MS);
+        duration_ms = BLE_HS_FOREVER;
+    }
 
-    rc = ble_gap_adv_start(ble_addr_type, NULL, BLE_HS_FOREVER, &adv_params, ble_gap_event, NULL);
+    rc = ble_gap_adv_start(ble_addr_type, NULL, duration_ms, &adv_params, ble_gap_event, NULL);
     if (rc != 0) {
         ESP_LOGE(TAG, "Error starting advertising: %d", rc);
-    } else {
-        ESP_LOGI(TAG, "BLE Advertising Started....!"); 
+        return;
+    }
+
+    s_adv_phase = phase;
+    s_adv_phase_start_us = esp_timer_get_time();
+    if (phase == ADV_PHASE_FAST) {
+        s_adv_cycle_start_us = s_adv_phase_start_us;
     }
+    dlog_str(DLOG_BLE_ADV_START, adv_phase_names[phase],
+             phase == ADV_PHASE_FAST ? BLE_ADV_FAST_ITVL_MIN_MS : BLE_ADV_SLOW_ITVL_MIN_MS,
+             phase == ADV_PHASE_FAST ? BLE_ADV_FAST_ITVL_MAX_MS : BLE_ADV_SLOW_ITVL_MAX_MS, 0, 0);
 }
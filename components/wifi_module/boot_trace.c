@@ -0,0 +1,111 @@
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "boot_trace.h"
+
+static const char *TAG = "TRACE";
+
+typedef struct {
+    atomic_uint seq;        // index + 1 once the slot is complete, 0 while it is written
+    int64_t t_us;
+    uint32_t arg;
+    uint8_t stage;
+} trace_slot_t;
+
+static trace_slot_t s_ring[BOOT_TRACE_RING_SIZE];
+static atomic_uint s_head = 0;
+static int64_t s_first_us[TRACE_STAGE_COUNT];
+static atomic_uint s_count[TRACE_STAGE_COUNT];
+
+static const char *stage_names[TRACE_STAGE_COUNT] = {
+    [TRACE_INIT_START]       = "init_start",
+    [TRACE_NVS_READY]        = "nvs_ready",
+    [TRACE_NETIF_READY]      = "netif_ready",
+    [TRACE_EVENT_LOOP_READY] = "event_loop_ready",
+    [TRACE_WIFI_INIT_DONE]   = "wifi_init_done",
+    [TRACE_WIFI_STARTED]     = "wifi_started",
+    [TRACE_SCAN_START]       = "scan_start",
+    [TRACE_SCAN_DONE]        = "scan_done",
+    [TRACE_STA_CONNECTED]    = "sta_connected",
+    [TRACE_GOT_IP]           = "got_ip",
+    [TRACE_PROBE_DONE]       = "probe_done",
+    [TRACE_SOFTAP_STARTED]   = "softap_started",
+    [TRACE_HTTPD_STARTED]    = "httpd_started",
+    [TRACE_BLE_STARTED]      = "ble_started",
+    [TRACE_BLE_CONNECTED]    = "ble_connected",
+    [TRACE_CREDS_RECEIVED]   = "creds_received",
+    [TRACE_PORTAL_CLOSED]    = "portal_closed",
+};
+
+void boot_trace_mark(boot_trace_stage_t stage, uint32_t arg) {
+    int64_t now_us = esp_timer_get_time();
+
+    if (stage >= TRACE_STAGE_COUNT) {
+        return;
+    }
+    // Claim a slot; writers never wait on each other or on readers
+    unsigned idx = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    trace_slot_t *slot = &s_ring[idx % BOOT_TRACE_RING_SIZE];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->t_us = now_us;
+    slot->arg = arg;
+    slot->stage = (uint8_t)stage;
+    atomic_store_explicit(&slot->seq, idx + 1, memory_order_release);
+
+    // Only the first writer of a stage sets this; a lost race costs a few microseconds of accuracy
+    if (s_first_us[stage] == 0) {
+        s_first_us[stage] = now_us;
+    }
+    atomic_fetch_add_explicit(&s_count[stage], 1, memory_order_relaxed);
+}
+
+bool boot_trace_read(uint32_t *cursor, boot_trace_entry_t *entry) {
+    unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+    unsigned oldest = head > BOOT_TRACE_RING_SIZE ? head - BOOT_TRACE_RING_SIZE : 0;
+
+    if (*cursor < oldest) {
+        *cursor = oldest;
+    }
+    while (*cursor < head) {
+        unsigned idx = (*cursor)++;
+        trace_slot_t *slot = &s_ring[idx % BOOT_TRACE_RING_SIZE];
+        unsigned seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != idx + 1) {
+            continue;       // being written or already overwritten
+        }
+        entry->t_us = slot->t_us;
+        entry->arg = slot->arg;
+        entry->stage = slot->stage;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void boot_trace_get_stage(boot_trace_stage_t stage, int64_t *first_us, uint32_t *count) {
+    *first_us = s_first_us[stage];
+    *count = atomic_load_explicit(&s_count[stage], memory_order_relaxed);
+}
+
+uint32_t boot_trace_total(void) {
+    return atomic_load_explicit(&s_head, memory_order_relaxed);
+}
+
+const char *boot_trace_stage_name(boot_trace_stage_t stage) {
+    return stage < TRACE_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+void boot_trace_dump_log(void) {
+    boot_trace_entry_t entry;
+    uint32_t cursor = 0;
+
+    ESP_LOGI(TAG, "begin,%u", (unsigned)boot_trace_total());
+    while (boot_trace_read(&cursor, &entry)) {
+        ESP_LOGI(TAG, "%s,%lld,%u", boot_trace_stage_name(entry.stage), entry.t_us, (unsigned)entry.arg);
+    }
+    ESP_LOGI(TAG, "end");
+}
@@ -0,0 +1,192 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "captive_dns.h"
+#include "utilities.h"
+
+static const char *TAG = "CAPTIVE_DNS";
+
+#define DNS_HEADER_LEN      12
+#define DNS_ANSWER_LEN      16      // name pointer, type, class, TTL, length, IPv4 address
+#define DNS_FLAG_QR         0x8000
+#define DNS_FLAG_AA         0x0400
+#define DNS_FLAG_RD         0x0100
+#define DNS_OPCODE_MASK     0x7800
+#define DNS_TYPE_A          1
+#define DNS_CLASS_IN        1
+
+static TaskHandle_t s_task = NULL;
+static volatile bool s_running = false;     // asks the task to keep serving
+static volatile bool s_serving = false;     // the socket is open; cleared once the port is free again
+#if PROV_STATIC_ALLOC
+static StaticTask_t s_task_storage;
+static StackType_t s_task_stack[CAPTIVE_DNS_STACK_SIZE];
+#endif
+static uint32_t s_ip;
+static captive_dns_stats_t s_stats;
+// Only the responder task touches it: the query is rewritten into the answer in place
+static uint8_t s_buf[CAPTIVE_DNS_BUF_LEN];
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+/* Turns the query in s_buf into its answer. Returns the answer length, or 0 to drop the packet. */
+static size_t build_answer(size_t len) {
+    if (len < DNS_HEADER_LEN) {
+        return 0;
+    }
+    uint16_t flags = get_u16(&s_buf[2]);
+    if ((flags & DNS_FLAG_QR) || (flags & DNS_OPCODE_MASK) || get_u16(&s_buf[4]) != 1) {
+        return 0;
+    }
+
+    // Walk the question's labels; compression pointers aren't valid in a question
+    size_t pos = DNS_HEADER_LEN;
+    while (pos < len && s_buf[pos] != 0) {
+        if (s_buf[pos] & 0xc0) {
+            return 0;
+        }
+        pos += s_buf[pos] + 1;
+    }
+    if (pos + 5 > len) {
+        return 0;
+    }
+    uint16_t qtype = get_u16(&s_buf[pos + 1]);
+    uint16_t qclass = get_u16(&s_buf[pos + 3]);
+    pos += 5;
+
+    // Anything after the question (EDNS options) is dropped from the reply
+    bool answer = (qtype == DNS_TYPE_A && qclass == DNS_CLASS_IN);
+    put_u16(&s_buf[2], DNS_FLAG_QR | DNS_FLAG_AA | (flags & DNS_FLAG_RD));
+    put_u16(&s_buf[6], answer ? 1 : 0);
+    put_u16(&s_buf[8], 0);
+    put_u16(&s_buf[10], 0);
+    if (!answer) {
+        // NOERROR with no records: AAAA lookups fall back to A instead of failing
+        s_stats.empty++;
+        return pos;
+    }
+    if (pos + DNS_ANSWER_LEN > sizeof(s_buf)) {
+        return 0;
+    }
+
+    uint8_t *ans = &s_buf[pos];
+    put_u16(&ans[0], 0xc000 | DNS_HEADER_LEN);
+    put_u16(&ans[2], DNS_TYPE_A);
+    put_u16(&ans[4], DNS_CLASS_IN);
+    put_u16(&ans[6], 0);
+    put_u16(&ans[8], CAPTIVE_DNS_TTL_S);
+    put_u16(&ans[10], 4);
+    memcpy(&ans[12], &s_ip, 4);
+    s_stats.answered++;
+    return pos + DNS_ANSWER_LEN;
+}
+
+static void serve(void) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CAPTIVE_DNS_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct timeval tv = {
+        .tv_sec = 0,
+        .tv_usec = CAPTIVE_DNS_POLL_MS * 1000,
+    };
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "Cannot listen on port %d: errno %d", CAPTIVE_DNS_PORT, errno);
+        if (sock >= 0) {
+            close(sock);
+        }
+        s_running = false;
+        return;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ESP_LOGI(TAG, "Answering DNS queries on port %d", CAPTIVE_DNS_PORT);
+
+    while (s_running) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(sock, s_buf, sizeof(s_buf), 0, (struct sockaddr *)&from, &from_len);
+        if (len <= 0) {
+            continue;       // timeout: re-check s_running
+        }
+        size_t out = build_answer((size_t)len);
+        if (out == 0) {
+            s_stats.dropped++;
+            continue;
+        }
+        sendto(sock, s_buf, out, 0, (struct sockaddr *)&from, from_len);
+    }
+
+    close(sock);
+    ESP_LOGI(TAG, "Stopped: %u answered, %u empty, %u dropped",
+             (unsigned)s_stats.answered, (unsigned)s_stats.empty, (unsigned)s_stats.dropped);
+}
+
+static void captive_dns_task(void *param) {
+    (void)param;
+#if PROV_STATIC_ALLOC
+    // Parked between portal sessions: a static task's TCB can't be reused safely until the idle task has reaped it
+    while (1) {
+        serve();
+        s_serving = false;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+#else
+    serve();
+    s_serving = false;
+    s_task = NULL;
+    vTaskDelete(NULL);
+#endif
+}
+
+esp_err_t captive_dns_start(uint32_t ip) {
+    if (s_serving) {
+        return ESP_OK;
+    }
+    s_ip = ip;
+    s_running = true;
+    s_serving = true;
+#if PROV_STATIC_ALLOC
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+        return ESP_OK;
+    }
+    s_task = xTaskCreateStaticPinnedToCore(captive_dns_task, "captive_dns", CAPTIVE_DNS_STACK_SIZE, NULL,
+                                           CAPTIVE_DNS_PRIORITY, s_task_stack, &s_task_storage, CAPTIVE_DNS_CORE);
+    bool created = (s_task != NULL);
+#else
+    bool created = (xTaskCreatePinnedToCore(captive_dns_task, "captive_dns", CAPTIVE_DNS_STACK_SIZE, NULL,
+                                            CAPTIVE_DNS_PRIORITY, &s_task, CAPTIVE_DNS_CORE) == pdPASS);
+#endif
+    if (!created) {
+        ESP_LOGE(TAG, "Failed to create DNS task");
+        s_running = false;
+        s_serving = false;
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void captive_dns_stop(void) {
+    s_running = false;
+    // The task notices within one receive timeout; wait so a restart can bind the port again
+    for (int i = 0; i < 4 && s_serving; i++) {
+        vTaskDelay(pdMS_TO_TICKS(CAPTIVE_DNS_POLL_MS));
+    }
+}
+
+void captive_dns_get_stats(captive_dns_stats_t *stats) {
+    *stats = s_stats;
+}
@@ -0,0 +1,239 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/dns.h"
+#include "lwip/sockets.h"
+#include "lwip/tcpip.h"
+#include "conn_check.h"
+
+static const char *TAG = "CONN_CHECK";
+
+ESP_EVENT_DEFINE_BASE(CONN_CHECK_EVENT);
+
+static const uint32_t s_hist_bounds[CONN_CHECK_HIST_BUCKETS] = CONN_CHECK_HIST_BOUNDS_MS;
+
+static conn_check_config_t s_config = {
+    .host = CONN_CHECK_DEFAULT_HOST,
+    .port = CONN_CHECK_DEFAULT_PORT,
+    .timeout_ms = CONN_CHECK_DEFAULT_TIMEOUT_MS,
+    .ttl_ms = CONN_CHECK_DEFAULT_TTL_MS,
+};
+static TaskHandle_t s_task = NULL;
+static volatile bool s_force = false;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static conn_check_result_t s_result;
+static conn_check_histograms_t s_hist;
+
+// Lookup handed to lwIP's resolver. The probe stops waiting after timeout_ms; an answer that comes
+// later carries an old generation and is dropped
+static SemaphoreHandle_t s_dns_done = NULL;
+static StaticSemaphore_t s_dns_done_storage;
+static uint32_t s_dns_gen;
+static bool s_dns_found;
+static uint32_t s_dns_addr;         // IPv4, network byte order
+
+static void hist_add(uint32_t *hist, uint32_t *sum_ms, uint32_t ms) {
+    *sum_ms += ms;
+    for (int i = 0; i < CONN_CHECK_HIST_BUCKETS; i++) {
+        if (ms <= s_hist_bounds[i]) {
+            hist[i]++;
+            return;
+        }
+    }
+}
+
+static bool result_fresh(const conn_check_result_t *result) {
+    return result->timestamp_us != 0 &&
+           (esp_timer_get_time() - result->timestamp_us) < (int64_t)s_config.ttl_ms * 1000;
+}
+
+static void dns_finish(uint32_t gen, const ip_addr_t *addr) {
+    bool current;
+
+    portENTER_CRITICAL(&s_lock);
+    current = (gen == s_dns_gen);
+    if (current) {
+        s_dns_found = (addr != NULL && IP_IS_V4(addr));
+        s_dns_addr = s_dns_found ? ip_2_ip4(addr)->addr : 0;
+        s_dns_gen++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (current) {
+        xSemaphoreGive(s_dns_done);
+    }
+}
+
+static void dns_found(const char *name, const ip_addr_t *addr, void *arg) {
+    (void)name;
+    dns_finish((uint32_t)(uintptr_t)arg, addr);
+}
+
+// Runs on the tcpip thread, where lwIP's resolver lives
+static void dns_start(void *arg) {
+    ip_addr_t addr;
+    err_t err = dns_gethostbyname(s_config.host, &addr, dns_found, arg);
+
+    if (err == ERR_OK) {
+        dns_finish((uint32_t)(uintptr_t)arg, &addr);
+    } else if (err != ERR_INPROGRESS) {
+        dns_finish((uint32_t)(uintptr_t)arg, NULL);
+    }
+}
+
+// Lookup bounded by the configured timeout, unlike getaddrinfo() which waits out lwIP's own retries
+static bool resolve(uint32_t *addr) {
+    portENTER_CRITICAL(&s_lock);
+    uint32_t gen = ++s_dns_gen;
+    portEXIT_CRITICAL(&s_lock);
+    // A give left over from a lookup that answered just as the last probe gave up
+    xSemaphoreTake(s_dns_done, 0);
+
+    if (tcpip_callback(dns_start, (void *)(uintptr_t)gen) != ERR_OK) {
+        return false;
+    }
+    bool answered = (xSemaphoreTake(s_dns_done, pdMS_TO_TICKS(s_config.timeout_ms)) == pdTRUE);
+
+    portENTER_CRITICAL(&s_lock);
+    if (!answered && s_dns_gen == gen) {
+        s_dns_gen++;
+    }
+    bool found = answered && s_dns_found;
+    *addr = s_dns_addr;
+    portEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+// Non-blocking connect bounded by the configured timeout
+static bool tcp_probe(uint32_t addr) {
+    struct sockaddr_in target = {
+        .sin_family = AF_INET,
+        .sin_port = htons(s_config.port),
+        .sin_addr.s_addr = addr,
+    };
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return false;
+    }
+
+    bool ok = false;
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(sock, (struct sockaddr *)&target, sizeof(target)) == 0) {
+        ok = true;
+    } else if (errno == EINPROGRESS) {
+        fd_set wfds;
+        struct timeval tv = {
+            .tv_sec = s_config.timeout_ms / 1000,
+            .tv_usec = (s_config.timeout_ms % 1000) * 1000,
+        };
+        FD_ZERO(&wfds);
+        FD_SET(sock, &wfds);
+        if (select(sock + 1, NULL, &wfds, NULL, &tv) > 0) {
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &so_error, &len);
+            ok = (so_error == 0);
+        }
+    }
+    close(sock);
+    return ok;
+}
+
+static void run_probe(void) {
+    conn_check_result_t result = {0};
+    uint32_t addr = 0;
+
+    int64_t start_us = esp_timer_get_time();
+    result.dns_ok = resolve(&addr);
+    int64_t dns_done_us = esp_timer_get_time();
+    result.dns_ms = (uint32_t)((dns_done_us - start_us) / 1000);
+
+    if (result.dns_ok) {
+        result.online = tcp_probe(addr);
+        result.tcp_ms = (uint32_t)((esp_timer_get_time() - dns_done_us) / 1000);
+    }
+    result.timestamp_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    s_result = result;
+    hist_add(s_hist.dns, &s_hist.dns_sum_ms, result.dns_ms);
+    if (result.dns_ok) {
+        hist_add(s_hist.tcp, &s_hist.tcp_sum_ms, result.tcp_ms);
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (result.online) {
+        ESP_LOGI(TAG, "%s:%u reachable (DNS %u ms, connect %u ms)", s_config.host, s_config.port,
+                 (unsigned)result.dns_ms, (unsigned)result.tcp_ms);
+    } else {
+        ESP_LOGW(TAG, "%s:%u unreachable (%s)", s_config.host, s_config.port,
+                 result.dns_ok ? "connect failed" : "DNS lookup failed");
+    }
+}
+
+static void conn_check_task(void *param) {
+    (void)param;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        conn_check_result_t cached;
+        bool fresh = conn_check_get_result(&cached);
+        if (s_force || !fresh) {
+            s_force = false;
+            run_probe();
+            conn_check_get_result(&cached);
+        }
+        esp_event_post(CONN_CHECK_EVENT, cached.online ? CONN_CHECK_EVENT_ONLINE : CONN_CHECK_EVENT_OFFLINE,
+                       &cached, sizeof(cached), 0);
+    }
+}
+
+esp_err_t conn_check_init(const conn_check_config_t *config) {
+    if (config != NULL) {
+        s_config = *config;
+    }
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+    s_dns_done = xSemaphoreCreateBinaryStatic(&s_dns_done_storage);
+    if (xTaskCreatePinnedToCore(conn_check_task, "conn_check", CONN_CHECK_STACK_SIZE, NULL, CONN_CHECK_PRIORITY,
+                                &s_task, CONN_CHECK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create connectivity check task");
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void conn_check_trigger(bool force) {
+    if (s_task == NULL) {
+        return;
+    }
+    if (force) {
+        s_force = true;
+    }
+    xTaskNotifyGive(s_task);
+}
+
+void conn_check_invalidate(void) {
+    portENTER_CRITICAL(&s_lock);
+    s_result.timestamp_us = 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool conn_check_get_result(conn_check_result_t *result) {
+    portENTER_CRITICAL(&s_lock);
+    *result = s_result;
+    portEXIT_CRITICAL(&s_lock);
+    return result_fresh(result);
+}
+
+void conn_check_get_histograms(conn_check_histograms_t *hist) {
+    portENTER_CRITICAL(&s_lock);
+    *hist = s_hist;
+    portEXIT_CRITICAL(&s_lock);
+}
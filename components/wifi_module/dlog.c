@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "dlog.h"
+
+static const char *TAG = "DLOG";
+
+typedef struct {
+    const char *tag;
+    esp_log_level_t level;
+    bool has_str;
+    bool secret;            // the string argument is a credential
+    const char *fmt;
+} dlog_def_t;
+
+#define MSG(id, tag, lvl, has_str, secret, fmt) [id] = { tag, ESP_LOG_##lvl, has_str, secret, fmt }
+
+static const dlog_def_t s_defs[DLOG_MSG_COUNT] = {
+    MSG(DLOG_WIFI_FAST_FAIL,       "WIFI_CONN",  WARN, false, false, "Fast connect failed, falling back to a scan"),
+    MSG(DLOG_WIFI_GOT_IP,          "WIFI_CONN",  INFO, false, false, "Success! Got IP: %u.%u.%u.%u"),
+    MSG(DLOG_WIFI_TIME_TO_IP,      "WIFI_CONN",  INFO, true,  false, "Time to IP (%s): %u ms since connect, %u ms since boot, free heap %u"),
+    MSG(DLOG_WIFI_CANDIDATE,       "WIFI_CONN",  INFO, true,  false, "Candidate %s (RSSI %d, channel %u)"),
+    MSG(DLOG_WIFI_CONNECTING,      "WIFI_CONN",  INFO, true,  false, "Connecting to %s..."),
+    MSG(DLOG_WIFI_FAST_HINT,       "WIFI_CONN",  INFO, true,  false, "Fast-connect cache updated for %s (channel %u, authmode %u)"),
+    MSG(DLOG_WIFI_NEXT_RECONNECT,  "WIFI_CONN",  INFO, false, false, "Next reconnect attempt in %u ms"),
+    MSG(DLOG_WIFI_RETRY,           "WIFI_CONN",  INFO, false, false, "No known network reachable. Retrying... (%u)"),
+    MSG(DLOG_SCAN_DONE,            "SCAN_CACHE", INFO, false, false, "Scan done: %u APs, %u distinct networks cached"),
+    MSG(DLOG_BLE_SSID,             "BLE_VISION", INFO, true,  false, "Received SSID via BLE: %s"),
+    MSG(DLOG_BLE_PASS,             "BLE_VISION", INFO, true,  true,  "Received PASS via BLE: %s"),
+    MSG(DLOG_BLE_HANDOFF,          "BLE_VISION", INFO, false, false, "Handing BLE credentials to the provisioning worker..."),
+    MSG(DLOG_BLE_TLV_REJECTED,     "BLE_VISION", WARN, false, false, "Rejected credential payload (%u bytes): error %u"),
+    MSG(DLOG_BLE_CREDS,            "BLE_VISION", INFO, true,  false, "Received credentials for %s via BLE (%u bytes, one write)"),
+    MSG(DLOG_BLE_STATUS_NO_MBUF,   "BLE_VISION", WARN, false, false, "No mbuf for status %u"),
+    MSG(DLOG_BLE_STATUS_FAILED,    "BLE_VISION", WARN, false, false, "Status %u not sent: %d"),
+    MSG(DLOG_BLE_CONNECTED,        "BLE_VISION", INFO, true,  false, "Client connected in %s phase, %u ms after advertising started"),
+    MSG(DLOG_BLE_MTU,              "BLE_VISION", INFO, false, false, "MTU negotiated: %u"),
+    MSG(DLOG_BLE_SUBSCRIBE,        "BLE_VISION", INFO, false, false, "Status subscription: notify=%u indicate=%u"),
+    MSG(DLOG_BLE_DISCONNECT,       "BLE_VISION", INFO, false, false, "Client gone after %u writes, %u reads, %u status pushes"),
+    MSG(DLOG_BLE_ADV_PHASE_END,    "BLE_VISION", INFO, true,  false, "Advertising %s phase ended after %u ms"),
+    MSG(DLOG_BLE_ADV_START,        "BLE_VISION", INFO, true,  false, "BLE advertising started (%s, %u-%u ms)"),
+    MSG(DLOG_WEB_CREDS,            "WEB_SERVER", INFO, true,  false, "Decoded SSID: %s, PASS: <%u chars>"),
+};
+
+typedef struct {
+    uint32_t ts_ms;
+    uint16_t msg;
+    char str[DLOG_STR_MAX];
+    uint32_t args[4];
+} dlog_record_t;
+
+typedef struct {
+    dlog_record_t records[DLOG_RING_LEN];
+    uint8_t head;
+    uint8_t count;
+    uint32_t dropped;
+    portMUX_TYPE lock;
+} dlog_ring_t;
+
+// One ring per core: producers only ever contend with tasks on their own core
+static dlog_ring_t s_rings[portNUM_PROCESSORS] = {
+    [0 ... portNUM_PROCESSORS - 1] = { .lock = portMUX_INITIALIZER_UNLOCKED },
+};
+static TaskHandle_t s_task = NULL;
+static uint32_t s_dropped_reported = 0;
+
+static portMUX_TYPE s_cb_lock = portMUX_INITIALIZER_UNLOCKED;
+static dlog_cb_stats_t s_cb_stats[DLOG_CB_COUNT];
+static const char *cb_names[DLOG_CB_COUNT] = { "wifi_event", "gatt", "httpd" };
+
+static void print_record(const dlog_record_t *rec) {
+    const dlog_def_t *def = &s_defs[rec->msg];
+    char line[160];
+
+    if (def->has_str) {
+        snprintf(line, sizeof(line), def->fmt, rec->str, rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+    } else {
+        snprintf(line, sizeof(line), def->fmt, rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+    }
+    // The record's own time, so late printing doesn't distort the timeline
+    ESP_LOG_LEVEL(def->level, def->tag, "[%u] %s", (unsigned)rec->ts_ms, line);
+}
+
+static void fill_record(dlog_record_t *rec, dlog_msg_t msg, const char *str,
+                        uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    rec->ts_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    rec->msg = (uint16_t)msg;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+    if (str == NULL) {
+        rec->str[0] = '\0';
+    } else if (s_defs[msg].secret) {
+        snprintf(rec->str, sizeof(rec->str), "<redacted, %u chars>", (unsigned)strlen(str));
+    } else {
+        strncpy(rec->str, str, sizeof(rec->str) - 1);
+        rec->str[sizeof(rec->str) - 1] = '\0';
+    }
+}
+
+void dlog_str(dlog_msg_t msg, const char *str, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    if (msg >= DLOG_MSG_COUNT || esp_log_level_get(s_defs[msg].tag) < s_defs[msg].level) {
+        return;
+    }
+    dlog_record_t rec;
+    fill_record(&rec, msg, str, a0, a1, a2, a3);
+#if DLOG_DEFERRED
+    dlog_ring_t *ring = &s_rings[xPortGetCoreID()];
+    bool wake = false;
+
+    // Only a copy happens with interrupts off; the record was built above
+    portENTER_CRITICAL(&ring->lock);
+    if (ring->count == DLOG_RING_LEN) {
+        ring->dropped++;
+    } else {
+        ring->records[(ring->head + ring->count) % DLOG_RING_LEN] = rec;
+        wake = (ring->count++ == 0);
+    }
+    portEXIT_CRITICAL(&ring->lock);
+
+    if (wake && s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+#else
+    print_record(&rec);
+#endif
+}
+
+static bool pop_record(dlog_ring_t *ring, dlog_record_t *rec) {
+    bool ok = false;
+
+    portENTER_CRITICAL(&ring->lock);
+    if (ring->count > 0) {
+        *rec = ring->records[ring->head];
+        ring->head = (ring->head + 1) % DLOG_RING_LEN;
+        ring->count--;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&ring->lock);
+    return ok;
+}
+
+static void dlog_task(void *param) {
+    (void)param;
+    dlog_record_t rec;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DLOG_FLUSH_MS));
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            while (pop_record(&s_rings[core], &rec)) {
+                print_record(&rec);
+            }
+        }
+        uint32_t dropped = dlog_get_dropped();
+        if (dropped != s_dropped_reported) {
+            ESP_LOGW(TAG, "%u log messages dropped (%u since boot)",
+                     (unsigned)(dropped - s_dropped_reported), (unsigned)dropped);
+            s_dropped_reported = dropped;
+        }
+    }
+}
+
+esp_err_t dlog_init(void) {
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+    if (xTaskCreatePinnedToCore(dlog_task, "dlog", DLOG_TASK_STACK, NULL, DLOG_TASK_PRIORITY, &s_task,
+                                DLOG_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create log task");
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+uint32_t dlog_get_dropped(void) {
+    uint32_t dropped = 0;
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        dropped += s_rings[core].dropped;
+    }
+    return dropped;
+}
+
+void dlog_time_callback(dlog_cb_t cb, int64_t start_us) {
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&s_cb_lock);
+    s_cb_stats[cb].count++;
+    s_cb_stats[cb].total_us += us;
+    if (us > s_cb_stats[cb].max_us) {
+        s_cb_stats[cb].max_us = us;
+    }
+    portEXIT_CRITICAL(&s_cb_lock);
+}
+
+void dlog_get_callback_stats(dlog_cb_t cb, dlog_cb_stats_t *stats) {
+    portENTER_CRITICAL(&s_cb_lock);
+    *stats = s_cb_stats[cb];
+    portEXIT_CRITICAL(&s_cb_lock);
+}
+
+const char *dlog_callback_name(dlog_cb_t cb) {
+    return cb < DLOG_CB_COUNT ? cb_names[cb] : "unknown";
+}
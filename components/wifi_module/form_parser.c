@@ -0,0 +1,75 @@
+#include "form_parser.h"
+
+int form_hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void form_parser_init(form_parser_t *parser, char *buf, size_t len) {
+    parser->cur = buf;
+    parser->end = buf + len;
+}
+
+// Decode from parser->cur up to (not including) a stop character, writing at *out.
+// Returns the stop character found, or 0 at the end of input.
+static char decode_token(form_parser_t *parser, char **out, char stop_a, char stop_b) {
+    char *r = parser->cur;
+    char *w = *out;
+
+    while (r < parser->end) {
+        char c = *r;
+        if (c == stop_a || c == stop_b) {
+            parser->cur = r + 1;
+            *out = w;
+            return c;
+        }
+        if (c == '+') {
+            *w++ = ' ';
+            r++;
+        } else if (c == '%' && parser->end - r >= 3 &&
+                   form_hex_value(r[1]) >= 0 && form_hex_value(r[2]) >= 0) {
+            *w++ = (char)((form_hex_value(r[1]) << 4) | form_hex_value(r[2]));
+            r += 3;
+        } else {
+            // Malformed escapes are passed through literally
+            *w++ = c;
+            r++;
+        }
+    }
+    parser->cur = r;
+    *out = w;
+    return 0;
+}
+
+bool form_parser_next(form_parser_t *parser, char **key, size_t *key_len, char **value, size_t *value_len) {
+    // Skip empty pairs ("a=1&&b=2")
+    while (parser->cur < parser->end && *parser->cur == '&') {
+        parser->cur++;
+    }
+    if (parser->cur >= parser->end) {
+        return false;
+    }
+
+    // The write position trails the read position, so the terminators below never overwrite unread input
+    char *w = parser->cur;
+    *key = w;
+    char stop = decode_token(parser, &w, '=', '&');
+    *key_len = w - *key;
+    *w = '\0';
+
+    if (stop != '=') {
+        // No value: point at the key's terminator
+        *value = w;
+        *value_len = 0;
+        return true;
+    }
+
+    *value = ++w;
+    decode_token(parser, &w, '&', '&');
+    *value_len = w - *value;
+    // At the very end the terminator lands on the byte after the input; callers reserve it
+    *w = '\0';
+    return true;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "form_parser.h"
+
+/*
+ * Microbenchmark for the /save form parser: the in-place single pass against the approach it replaced
+ * (one lookup per key over the whole query, a copy of each value, then a separate decode pass).
+ *
+ *   bench_form_parser [iterations]
+ */
+
+static const char *forms[] = {
+    "ssid=HomeNet&pass=secret123",
+    "ssid=My+Home+WiFi+5G&pass=p%40ssw0rd%21with%20spaces%20and%20more",
+    "pass=%F0%9F%98%80%F0%9F%98%80%F0%9F%98%80%F0%9F%98%80&ssid=%E2%9C%93%E2%9C%93%E2%9C%93%E2%9C%93",
+};
+
+static volatile size_t s_sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// What httpd_query_key_value() does: find "key=" at the start of a pair and copy the raw value out
+static int lookup_copy(const char *query, const char *key, char *out, size_t out_len) {
+    size_t key_len = strlen(key);
+    const char *p = query;
+    while (*p) {
+        if (strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            const char *v = p + key_len + 1;
+            size_t n = strcspn(v, "&");
+            if (n >= out_len) {
+                return -1;
+            }
+            memcpy(out, v, n);
+            out[n] = '\0';
+            return 0;
+        }
+        p += strcspn(p, "&");
+        if (*p == '&') {
+            p++;
+        }
+    }
+    return -1;
+}
+
+static void url_decode(char *dst, const char *src) {
+    while (*src) {
+        if (*src == '%' && form_hex_value(src[1]) >= 0 && form_hex_value(src[2]) >= 0) {
+            *dst++ = (char)((form_hex_value(src[1]) << 4) | form_hex_value(src[2]));
+            src += 3;
+        } else if (*src == '+') {
+            *dst++ = ' ';
+            src++;
+        } else {
+            *dst++ = *src++;
+        }
+    }
+    *dst = '\0';
+}
+
+static size_t parse_lookup(const char *form) {
+    char query[128], ssid[128], pass[128], decoded_ssid[128], decoded_pass[128];
+    strncpy(query, form, sizeof(query) - 1);
+    query[sizeof(query) - 1] = '\0';
+    if (lookup_copy(query, "ssid", ssid, sizeof(ssid)) != 0 || lookup_copy(query, "pass", pass, sizeof(pass)) != 0) {
+        return 0;
+    }
+    url_decode(decoded_ssid, ssid);
+    url_decode(decoded_pass, pass);
+    return strlen(decoded_ssid) + strlen(decoded_pass);
+}
+
+static size_t parse_in_place(const char *form) {
+    char buf[128];
+    size_t len = strlen(form);
+    memcpy(buf, form, len);
+
+    form_parser_t parser;
+    char *key, *value;
+    size_t key_len, value_len, total = 0;
+    form_parser_init(&parser, buf, len);
+    while (form_parser_next(&parser, &key, &key_len, &value, &value_len)) {
+        if (strcmp(key, "ssid") == 0 || strcmp(key, "pass") == 0) {
+            total += value_len;
+        }
+    }
+    return total;
+}
+
+static double bench(size_t (*fn)(const char *), const char *form, long iterations) {
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        s_sink += fn(form);
+    }
+    return (now_ns() - start) / iterations;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    printf("%-6s %6s %12s %12s\n", "form", "bytes", "lookup ns", "in-place ns");
+    for (size_t i = 0; i < sizeof(forms) / sizeof(forms[0]); i++) {
+        if (parse_lookup(forms[i]) != parse_in_place(forms[i])) {
+            fprintf(stderr, "form %zu: parsers disagree\n", i);
+            return 1;
+        }
+        double lookup = bench(parse_lookup, forms[i], iterations);
+        double in_place = bench(parse_in_place, forms[i], iterations);
+        printf("%-6zu %6zu %12.1f %12.1f\n", i, strlen(forms[i]), lookup, in_place);
+    }
+    return 0;
+}
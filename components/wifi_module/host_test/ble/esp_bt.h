@@ -0,0 +1,16 @@
+#ifndef BLE_MOCK_ESP_BT_H
+#define BLE_MOCK_ESP_BT_H
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_BT_MODE_IDLE,
+    ESP_BT_MODE_BLE,
+    ESP_BT_MODE_CLASSIC_BT,
+    ESP_BT_MODE_BTDM,
+} esp_bt_mode_t;
+
+// Like the real one: the controller cannot be initialised again once its memory is released
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef BLE_MOCK_BLE_HS_H
+#define BLE_MOCK_BLE_HS_H
+
+/*
+ * The slice of the NimBLE host API ble_provisioning.c uses, as declared by ESP-IDF 5.1. The mock in
+ * nimble_mock.c keeps no stack: calls succeed and are counted, mbufs are flat buffers.
+ */
+
+#include <stdint.h>
+
+#define BLE_HS_EALREADY                 2
+#define BLE_HS_EMSGSIZE                 4
+#define BLE_HS_ENOMEM                   6
+#define BLE_HS_ENOTCONN                 7
+#define BLE_HS_FOREVER                  INT32_MAX
+#define BLE_HS_CONN_HANDLE_NONE         0xffff
+#define BLE_HS_ADV_F_DISC_GEN           0x02
+#define BLE_HS_ADV_F_BREDR_UNSUP        0x04
+#define BLE_HS_ADV_TX_PWR_LVL_AUTO      (-128)
+#define BLE_ERR_REM_USER_CONN_TERM      0x13
+
+#define BLE_ATT_ERR_READ_NOT_PERMITTED      0x02
+#define BLE_ATT_ERR_WRITE_NOT_PERMITTED     0x03
+#define BLE_ATT_ERR_REQ_NOT_SUPPORTED       0x06
+#define BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN  0x0d
+#define BLE_ATT_ERR_UNLIKELY                0x0e
+#define BLE_ATT_ERR_INSUFFICIENT_RES        0x11
+#define BLE_ATT_ATTR_MAX_LEN                512
+
+// ---- UUIDs ----
+
+typedef struct {
+    uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+    ble_uuid_t u;
+    uint16_t value;
+} ble_uuid16_t;
+
+typedef struct {
+    ble_uuid_t u;
+    uint8_t value[16];
+} ble_uuid128_t;
+
+#define BLE_UUID16_INIT(v)      { .u = { 16 }, .value = (v) }
+#define BLE_UUID128_INIT(...)   { .u = { 128 }, .value = { __VA_ARGS__ } }
+#define BLE_UUID16_DECLARE(v)   ((const ble_uuid_t *)(&(ble_uuid16_t)BLE_UUID16_INIT(v)))
+
+uint16_t ble_uuid_u16(const ble_uuid_t *uuid);
+int ble_uuid_cmp(const ble_uuid_t *a, const ble_uuid_t *b);
+
+// ---- OS glue ----
+
+struct os_mbuf {
+    uint16_t len;
+    uint8_t data[BLE_ATT_ATTR_MAX_LEN];
+};
+
+#define OS_MBUF_PKTLEN(om) ((om)->len)
+
+struct ble_npl_event;
+typedef void ble_npl_event_fn(struct ble_npl_event *ev);
+
+struct ble_npl_event {
+    ble_npl_event_fn *fn;
+    void *arg;
+};
+
+struct ble_npl_eventq {
+    int unused;
+};
+
+void ble_npl_event_init(struct ble_npl_event *ev, ble_npl_event_fn *fn, void *arg);
+void ble_npl_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev);
+void *ble_npl_event_get_arg(struct ble_npl_event *ev);
+
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len);
+int ble_hs_mbuf_to_flat(const struct os_mbuf *om, void *flat, uint16_t max_len, uint16_t *out_copy_len);
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len);
+
+// ---- GATT server ----
+
+#define BLE_GATT_SVC_TYPE_PRIMARY       1
+#define BLE_GATT_CHR_F_READ             0x0002
+#define BLE_GATT_CHR_F_WRITE_NO_RSP     0x0004
+#define BLE_GATT_CHR_F_WRITE            0x0008
+#define BLE_GATT_CHR_F_NOTIFY           0x0010
+#define BLE_GATT_CHR_F_INDICATE         0x0020
+#define BLE_GATT_ACCESS_OP_READ_CHR     0
+#define BLE_GATT_ACCESS_OP_WRITE_CHR    1
+
+struct ble_gatt_access_ctxt;
+typedef int ble_gatt_access_fn(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt,
+                               void *arg);
+
+struct ble_gatt_chr_def {
+    const ble_uuid_t *uuid;
+    ble_gatt_access_fn *access_cb;
+    void *arg;
+    void *descriptors;
+    uint16_t flags;
+    uint8_t min_key_size;
+    uint16_t *val_handle;
+};
+
+struct ble_gatt_svc_def {
+    uint8_t type;
+    const ble_uuid_t *uuid;
+    const struct ble_gatt_svc_def **includes;
+    const struct ble_gatt_chr_def *characteristics;
+};
+
+struct ble_gatt_access_ctxt {
+    uint8_t op;
+    struct os_mbuf *om;
+    union {
+        const struct ble_gatt_chr_def *chr;
+    };
+};
+
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs);
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *defs);
+int ble_gatts_notify_custom(uint16_t conn_handle, uint16_t chr_val_handle, struct os_mbuf *om);
+int ble_gatts_indicate_custom(uint16_t conn_handle, uint16_t chr_val_handle, struct os_mbuf *om);
+void ble_gatts_chr_updated(uint16_t chr_val_handle);
+int ble_gattc_exchange_mtu(uint16_t conn_handle, void *cb, void *cb_arg);
+
+// ---- GAP ----
+
+typedef struct {
+    uint8_t type;
+    uint8_t val[6];
+} ble_addr_t;
+
+struct ble_gap_conn_desc {
+    uint16_t conn_handle;
+};
+
+#define BLE_GAP_EVENT_CONNECT           0
+#define BLE_GAP_EVENT_DISCONNECT        1
+#define BLE_GAP_EVENT_ADV_COMPLETE      9
+#define BLE_GAP_EVENT_NOTIFY_TX         13
+#define BLE_GAP_EVENT_SUBSCRIBE         14
+#define BLE_GAP_EVENT_MTU               15
+
+struct ble_gap_event {
+    uint8_t type;
+    union {
+        struct {
+            int status;
+            uint16_t conn_handle;
+        } connect;
+        struct {
+            int reason;
+            struct ble_gap_conn_desc conn;
+        } disconnect;
+        struct {
+            int reason;
+        } adv_complete;
+        struct {
+            uint16_t conn_handle;
+            uint16_t attr_handle;
+            uint8_t reason;
+            uint8_t prev_notify:1;
+            uint8_t cur_notify:1;
+            uint8_t prev_indicate:1;
+            uint8_t cur_indicate:1;
+        } subscribe;
+        struct {
+            uint16_t conn_handle;
+            uint16_t channel_id;
+            uint16_t value;
+        } mtu;
+        struct {
+            uint16_t conn_handle;
+            uint16_t attr_handle;
+            uint8_t status;
+            uint8_t indication:1;
+        } notify_tx;
+    };
+};
+
+typedef int ble_gap_event_fn(struct ble_gap_event *event, void *arg);
+
+#define BLE_GAP_CONN_MODE_UND           2
+#define BLE_GAP_DISC_MODE_GEN           2
+#define BLE_GAP_ADV_FAST_INTERVAL1_MIN  48
+#define BLE_GAP_ADV_FAST_INTERVAL1_MAX  96
+#define BLE_GAP_ADV_ITVL_MS(t)          ((t) * 1000 / 625)
+
+struct ble_gap_adv_params {
+    uint8_t conn_mode;
+    uint8_t disc_mode;
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    uint8_t channel_map;
+    uint8_t filter_policy;
+    uint8_t high_duty_cycle;
+};
+
+struct ble_hs_adv_fields {
+    uint8_t flags;
+    const ble_uuid16_t *uuids16;
+    uint8_t num_uuids16;
+    unsigned uuids16_is_complete:1;
+    const ble_uuid128_t *uuids128;
+    uint8_t num_uuids128;
+    unsigned uuids128_is_complete:1;
+    const uint8_t *name;
+    uint8_t name_len;
+    unsigned name_is_complete:1;
+    int8_t tx_pwr_lvl;
+    unsigned tx_pwr_lvl_is_present:1;
+    uint16_t appearance;
+    unsigned appearance_is_present:1;
+};
+
+int ble_gap_adv_set_fields(const struct ble_hs_adv_fields *fields);
+int ble_gap_adv_rsp_set_fields(const struct ble_hs_adv_fields *fields);
+int ble_gap_adv_start(uint8_t own_addr_type, const ble_addr_t *direct_addr, int32_t duration_ms,
+                      const struct ble_gap_adv_params *params, ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_adv_stop(void);
+int ble_gap_adv_active(void);
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason);
+int ble_hs_id_infer_auto(int privacy, uint8_t *out_addr_type);
+
+// ---- ATT and host config ----
+
+int ble_att_set_preferred_mtu(uint16_t mtu);
+uint16_t ble_att_preferred_mtu(void);
+uint16_t ble_att_mtu(uint16_t conn_handle);
+
+struct ble_hs_cfg {
+    void (*sync_cb)(void);
+    void (*reset_cb)(int reason);
+    void *gatts_register_cb;
+};
+
+extern struct ble_hs_cfg ble_hs_cfg;
+
+#endif
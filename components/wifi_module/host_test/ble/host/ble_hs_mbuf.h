@@ -0,0 +1,6 @@
+#ifndef BLE_MOCK_BLE_HS_MBUF_H
+#define BLE_MOCK_BLE_HS_MBUF_H
+
+#include "host/ble_hs.h"
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BLE_MOCK_UTIL_H
+#define BLE_MOCK_UTIL_H
+
+#include "host/ble_hs.h"
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef BLE_MOCK_NIMBLE_PORT_H
+#define BLE_MOCK_NIMBLE_PORT_H
+
+#include "esp_err.h"
+#include "host/ble_hs.h"
+
+// Initialises the controller as well as the host in IDF 5.x, and deinit shuts both down
+esp_err_t nimble_port_init(void);
+esp_err_t nimble_port_deinit(void);
+int nimble_port_stop(void);
+void nimble_port_run(void);
+struct ble_npl_eventq *nimble_port_get_dflt_eventq(void);
+
+#endif
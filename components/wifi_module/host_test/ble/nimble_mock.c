@@ -0,0 +1,238 @@
+// The NimBLE host and BT controller calls ble_provisioning.c makes, counted in nimble_mock. The host
+// "syncs" as soon as its task is started, so start_ble_provisioning() goes straight to advertising.
+#include <string.h>
+#include "esp_bt.h"
+#include "host/ble_hs.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#include "nimble_mock.h"
+
+nimble_mock_t nimble_mock;
+struct ble_hs_cfg ble_hs_cfg;
+
+static struct ble_npl_eventq s_dflt_eventq;
+static struct os_mbuf s_mbuf;
+static uint16_t s_preferred_mtu = 256;
+static bool s_adv_active = false;
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) {
+    (void)mode;
+    if (nimble_mock.controller_up) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    nimble_mock.mem_release++;
+    nimble_mock.mem_released = true;
+    return ESP_OK;
+}
+
+esp_err_t nimble_port_init(void) {
+    if (nimble_mock.mem_released || nimble_mock.controller_up) {
+        nimble_mock.port_init_refused++;
+        return ESP_ERR_INVALID_STATE;
+    }
+    nimble_mock.port_init++;
+    nimble_mock.controller_up = true;
+    return ESP_OK;
+}
+
+esp_err_t nimble_port_deinit(void) {
+    nimble_mock.port_deinit++;
+    nimble_mock.controller_up = false;
+    return ESP_OK;
+}
+
+int nimble_port_stop(void) {
+    return 0;
+}
+
+void nimble_port_run(void) {
+}
+
+struct ble_npl_eventq *nimble_port_get_dflt_eventq(void) {
+    return &s_dflt_eventq;
+}
+
+void nimble_port_freertos_init(TaskFunction_t host_task_fn) {
+    (void)host_task_fn;
+    if (ble_hs_cfg.sync_cb != NULL) {
+        ble_hs_cfg.sync_cb();
+    }
+}
+
+void nimble_port_freertos_deinit(void) {
+}
+
+void ble_npl_event_init(struct ble_npl_event *ev, ble_npl_event_fn *fn, void *arg) {
+    ev->fn = fn;
+    ev->arg = arg;
+}
+
+void ble_npl_eventq_put(struct ble_npl_eventq *evq, struct ble_npl_event *ev) {
+    (void)evq;
+    (void)ev;
+}
+
+void *ble_npl_event_get_arg(struct ble_npl_event *ev) {
+    return ev->arg;
+}
+
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len) {
+    if (len > sizeof(s_mbuf.data)) {
+        return NULL;
+    }
+    memcpy(s_mbuf.data, buf, len);
+    s_mbuf.len = len;
+    return &s_mbuf;
+}
+
+int ble_hs_mbuf_to_flat(const struct os_mbuf *om, void *flat, uint16_t max_len, uint16_t *out_copy_len) {
+    uint16_t len = om->len < max_len ? om->len : max_len;
+    memcpy(flat, om->data, len);
+    if (out_copy_len != NULL) {
+        *out_copy_len = len;
+    }
+    return om->len > max_len ? BLE_HS_EMSGSIZE : 0;
+}
+
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len) {
+    if (om->len + len > (int)sizeof(om->data)) {
+        return BLE_HS_ENOMEM;
+    }
+    memcpy(om->data + om->len, data, len);
+    om->len += len;
+    return 0;
+}
+
+uint16_t ble_uuid_u16(const ble_uuid_t *uuid) {
+    return uuid->type == 16 ? ((const ble_uuid16_t *)uuid)->value : 0;
+}
+
+int ble_uuid_cmp(const ble_uuid_t *a, const ble_uuid_t *b) {
+    if (a->type != b->type) {
+        return a->type - b->type;
+    }
+    if (a->type == 16) {
+        return ble_uuid_u16(a) - ble_uuid_u16(b);
+    }
+    return memcmp(((const ble_uuid128_t *)a)->value, ((const ble_uuid128_t *)b)->value, 16);
+}
+
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs) {
+    (void)defs;
+    return 0;
+}
+
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *defs) {
+    (void)defs;
+    return 0;
+}
+
+int ble_gatts_notify_custom(uint16_t conn_handle, uint16_t chr_val_handle, struct os_mbuf *om) {
+    (void)conn_handle;
+    (void)chr_val_handle;
+    (void)om;
+    return 0;
+}
+
+int ble_gatts_indicate_custom(uint16_t conn_handle, uint16_t chr_val_handle, struct os_mbuf *om) {
+    (void)conn_handle;
+    (void)chr_val_handle;
+    (void)om;
+    return 0;
+}
+
+void ble_gatts_chr_updated(uint16_t chr_val_handle) {
+    (void)chr_val_handle;
+}
+
+int ble_gattc_exchange_mtu(uint16_t conn_handle, void *cb, void *cb_arg) {
+    (void)conn_handle;
+    (void)cb;
+    (void)cb_arg;
+    return 0;
+}
+
+int ble_gap_adv_set_fields(const struct ble_hs_adv_fields *fields) {
+    (void)fields;
+    return 0;
+}
+
+int ble_gap_adv_rsp_set_fields(const struct ble_hs_adv_fields *fields) {
+    (void)fields;
+    return 0;
+}
+
+int ble_gap_adv_start(uint8_t own_addr_type, const ble_addr_t *direct_addr, int32_t duration_ms,
+                      const struct ble_gap_adv_params *params, ble_gap_event_fn *cb, void *cb_arg) {
+    (void)own_addr_type;
+    (void)direct_addr;
+    (void)duration_ms;
+    (void)params;
+    (void)cb;
+    (void)cb_arg;
+    if (!nimble_mock.controller_up) {
+        return BLE_HS_ENOTCONN;
+    }
+    if (s_adv_active) {
+        return BLE_HS_EALREADY;
+    }
+    nimble_mock.adv_start++;
+    s_adv_active = true;
+    return 0;
+}
+
+int ble_gap_adv_stop(void) {
+    if (!s_adv_active) {
+        return BLE_HS_EALREADY;
+    }
+    nimble_mock.adv_stop++;
+    s_adv_active = false;
+    return 0;
+}
+
+int ble_gap_adv_active(void) {
+    return s_adv_active;
+}
+
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason) {
+    (void)conn_handle;
+    (void)hci_reason;
+    return BLE_HS_ENOTCONN;
+}
+
+int ble_hs_id_infer_auto(int privacy, uint8_t *out_addr_type) {
+    (void)privacy;
+    *out_addr_type = 0;
+    return 0;
+}
+
+int ble_att_set_preferred_mtu(uint16_t mtu) {
+    s_preferred_mtu = mtu;
+    return 0;
+}
+
+uint16_t ble_att_preferred_mtu(void) {
+    return s_preferred_mtu;
+}
+
+uint16_t ble_att_mtu(uint16_t conn_handle) {
+    (void)conn_handle;
+    return s_preferred_mtu;
+}
+
+void ble_svc_gap_init(void) {
+}
+
+int ble_svc_gap_device_name_set(const char *name) {
+    (void)name;
+    return 0;
+}
+
+const char *ble_svc_gap_device_name(void) {
+    return "";
+}
+
+void ble_svc_gatt_init(void) {
+}
@@ -0,0 +1,23 @@
+#ifndef BLE_MOCK_NIMBLE_MOCK_H
+#define BLE_MOCK_NIMBLE_MOCK_H
+
+#include <stdbool.h>
+
+/*
+ * What the mocked controller and host have been asked to do. Like ESP-IDF's, the controller can be
+ * initialised again after nimble_port_deinit(), but never after its memory has been released.
+ */
+typedef struct {
+    int port_init;              // nimble_port_init() calls that brought the controller up
+    int port_init_refused;      // nimble_port_init() calls after the memory was released
+    int port_deinit;
+    int mem_release;
+    int adv_start;
+    int adv_stop;
+    bool controller_up;
+    bool mem_released;
+} nimble_mock_t;
+
+extern nimble_mock_t nimble_mock;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef BLE_MOCK_BLE_SVC_GAP_H
+#define BLE_MOCK_BLE_SVC_GAP_H
+
+#include "host/ble_hs.h"
+
+void ble_svc_gap_init(void);
+int ble_svc_gap_device_name_set(const char *name);
+const char *ble_svc_gap_device_name(void);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BLE_MOCK_BLE_SVC_GATT_H
+#define BLE_MOCK_BLE_SVC_GATT_H
+
+void ble_svc_gatt_init(void);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOST_TEST_MBEDTLS_MD_H
+#define HOST_TEST_MBEDTLS_MD_H
+
+// Just enough of mbedtls/md.h for wifi_psk.c on hosts without mbedtls 3
+typedef enum {
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_SHA1,
+} mbedtls_md_type_t;
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef HOST_TEST_MBEDTLS_PKCS5_H
+#define HOST_TEST_MBEDTLS_PKCS5_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <openssl/evp.h>
+#include "mbedtls/md.h"
+
+// mbedtls 3.x PBKDF2 entry point, answered by OpenSSL's implementation
+static inline int mbedtls_pkcs5_pbkdf2_hmac_ext(mbedtls_md_type_t md_type, const unsigned char *password,
+                                                size_t plen, const unsigned char *salt, size_t slen,
+                                                unsigned int iteration_count, uint32_t key_length,
+                                                unsigned char *output) {
+    if (md_type != MBEDTLS_MD_SHA1) {
+        return -1;
+    }
+    return PKCS5_PBKDF2_HMAC((const char *)password, (int)plen, salt, (int)slen, (int)iteration_count,
+                             EVP_sha1(), (int)key_length, output) == 1 ? 0 : -1;
+}
+
+#endif
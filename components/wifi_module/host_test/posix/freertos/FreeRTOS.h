@@ -0,0 +1,32 @@
+#ifndef HOST_POSIX_FREERTOS_H
+#define HOST_POSIX_FREERTOS_H
+
+/*
+ * The slice of FreeRTOS that conn_check.c uses, on POSIX threads: tasks are pthreads, ticks are
+ * milliseconds and a critical section is a mutex.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  0
+#define pdPASS                  1
+#define portMAX_DELAY           UINT32_MAX
+#define portNUM_PROCESSORS      2
+#define tskNO_AFFINITY          0x7fffffff
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(mux)
+
+#endif
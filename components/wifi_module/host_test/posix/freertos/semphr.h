@@ -0,0 +1,18 @@
+#ifndef HOST_POSIX_SEMPHR_H
+#define HOST_POSIX_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+// Binary semaphores only; the static storage is the semaphore itself
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool given;
+} StaticSemaphore_t;
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *storage);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#endif
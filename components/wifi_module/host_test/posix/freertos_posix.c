@@ -0,0 +1,128 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *param;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+static __thread struct host_task *s_self;
+
+static void *task_main(void *arg) {
+    struct host_task *task = arg;
+    s_self = task;
+    task->fn(task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+    (void)core;
+    struct host_task *task = calloc(1, sizeof(*task));
+    task->fn = fn;
+    task->param = param;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    if (handle != NULL) {
+        *handle = task;
+    }
+    if (pthread_create(&task->thread, NULL, task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+static struct timespec deadline_after(TickType_t ticks) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct host_task *task = s_self;
+    struct timespec deadline = deadline_after(ticks);
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify == 0) {
+        int rc = ticks == portMAX_DELAY ? pthread_cond_wait(&task->cond, &task->lock)
+                                        : pthread_cond_timedwait(&task->cond, &task->lock, &deadline);
+        if (rc == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t value = task->notify;
+    if (value > 0) {
+        task->notify = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    (void)task;
+    pthread_exit(NULL);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *storage) {
+    pthread_mutex_init(&storage->lock, NULL);
+    pthread_cond_init(&storage->cond, NULL);
+    storage->given = false;
+    return storage;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    struct timespec deadline = deadline_after(ticks);
+
+    pthread_mutex_lock(&sem->lock);
+    while (!sem->given && ticks != 0) {
+        int rc = ticks == portMAX_DELAY ? pthread_cond_wait(&sem->cond, &sem->lock)
+                                        : pthread_cond_timedwait(&sem->cond, &sem->lock, &deadline);
+        if (rc == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool taken = sem->given;
+    sem->given = false;
+    pthread_mutex_unlock(&sem->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    pthread_mutex_lock(&sem->lock);
+    bool was_given = sem->given;
+    sem->given = true;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return was_given ? pdFALSE : pdTRUE;
+}
@@ -0,0 +1,151 @@
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "lwip/dns.h"
+#include "lwip/sockets.h"
+#include "lwip/tcpip.h"
+
+uint16_t host_dns_server_port;
+
+// How long the stand-in resolver waits for an answer; the probe's own bound is usually shorter
+#define DNS_TIMEOUT_MS 2000
+
+static size_t encode_query(uint8_t *buf, size_t cap, uint16_t id, const char *name) {
+    size_t len = 12;
+    memset(buf, 0, 12);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xff;
+    buf[2] = 0x01;  // recursion desired
+    buf[5] = 1;     // one question
+    for (const char *label = name; *label != '\0';) {
+        const char *dot = strchr(label, '.');
+        size_t n = dot ? (size_t)(dot - label) : strlen(label);
+        if (n == 0 || n > 63 || len + n + 1 + 5 > cap) {
+            return 0;
+        }
+        buf[len++] = (uint8_t)n;
+        memcpy(buf + len, label, n);
+        len += n;
+        label += n + (dot ? 1 : 0);
+    }
+    buf[len++] = 0;
+    buf[len++] = 0;
+    buf[len++] = 1;  // type A
+    buf[len++] = 0;
+    buf[len++] = 1;  // class IN
+    return len;
+}
+
+static size_t skip_name(const uint8_t *buf, size_t len, size_t pos) {
+    while (pos < len) {
+        if ((buf[pos] & 0xc0) == 0xc0) {
+            return pos + 2;
+        }
+        if (buf[pos] == 0) {
+            return pos + 1;
+        }
+        pos += buf[pos] + 1;
+    }
+    return len + 1;
+}
+
+// First A record of a reply, or -1 if the reply carries none
+static int parse_answer(const uint8_t *buf, size_t len, uint16_t id, struct in_addr *addr) {
+    if (len < 12 || ((buf[0] << 8) | buf[1]) != id || !(buf[2] & 0x80) || (buf[3] & 0x0f) != 0) {
+        return -1;
+    }
+    unsigned qdcount = (buf[4] << 8) | buf[5];
+    unsigned ancount = (buf[6] << 8) | buf[7];
+    size_t pos = 12;
+    for (unsigned i = 0; i < qdcount; i++) {
+        pos = skip_name(buf, len, pos) + 4;
+    }
+    for (unsigned i = 0; i < ancount && pos <= len; i++) {
+        pos = skip_name(buf, len, pos);
+        if (pos + 10 > len) {
+            return -1;
+        }
+        unsigned type = (buf[pos] << 8) | buf[pos + 1];
+        unsigned rdlen = (buf[pos + 8] << 8) | buf[pos + 9];
+        pos += 10;
+        if (pos + rdlen > len) {
+            return -1;
+        }
+        if (type == 1 && rdlen == 4) {
+            memcpy(addr, buf + pos, 4);
+            return 0;
+        }
+        pos += rdlen;
+    }
+    return -1;
+}
+
+// One blocking query to the loopback server
+static int query(const char *name, struct in_addr *addr) {
+    uint8_t buf[512];
+    uint16_t id = (uint16_t)rand();
+    size_t qlen = encode_query(buf, sizeof(buf), id, name);
+    if (qlen == 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct timeval tv = { .tv_sec = DNS_TIMEOUT_MS / 1000, .tv_usec = (DNS_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in server = { .sin_family = AF_INET, .sin_port = htons(host_dns_server_port),
+                                  .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    int rc = -1;
+    if (sendto(fd, buf, qlen, 0, (struct sockaddr *)&server, sizeof(server)) == (ssize_t)qlen) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            rc = parse_answer(buf, (size_t)n, id, addr);
+        }
+    }
+    close(fd);
+    return rc;
+}
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg) {
+    (void)addr;
+    struct in_addr in;
+    ip_addr_t answer;
+
+    if (query(hostname, &in) == 0) {
+        answer.addr = in.s_addr;
+        found(hostname, &answer, callback_arg);
+    } else {
+        found(hostname, NULL, callback_arg);
+    }
+    return ERR_INPROGRESS;
+}
+
+struct tcpip_job {
+    tcpip_callback_fn fn;
+    void *ctx;
+};
+
+static void *tcpip_job_main(void *arg) {
+    struct tcpip_job job = *(struct tcpip_job *)arg;
+    free(arg);
+    job.fn(job.ctx);
+    return NULL;
+}
+
+err_t tcpip_callback(tcpip_callback_fn fn, void *ctx) {
+    struct tcpip_job *job = malloc(sizeof(*job));
+    pthread_t thread;
+
+    job->fn = fn;
+    job->ctx = ctx;
+    if (pthread_create(&thread, NULL, tcpip_job_main, job) != 0) {
+        free(job);
+        return ERR_ARG;
+    }
+    pthread_detach(thread);
+    return ERR_OK;
+}
@@ -0,0 +1,31 @@
+#ifndef HOST_POSIX_LWIP_DNS_H
+#define HOST_POSIX_LWIP_DNS_H
+
+#include <stdint.h>
+
+/*
+ * lwIP's asynchronous resolver, IPv4 only. Lookups go to a DNS server the test runs on the loopback
+ * (host_dns_server_port) instead of the host's resolver, so the probe's DNS step is exercised over
+ * real UDP with answers, delays and silences the test controls.
+ */
+
+typedef int8_t err_t;
+#define ERR_OK          0
+#define ERR_INPROGRESS  -5
+#define ERR_ARG         -16
+
+typedef struct {
+    uint32_t addr;              // network byte order
+} ip4_addr_t;
+typedef ip4_addr_t ip_addr_t;
+#define IP_IS_V4(ipaddr)        1
+#define ip_2_ip4(ipaddr)        (ipaddr)
+
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+
+extern uint16_t host_dns_server_port;
+
+// Always answers through the callback, from the calling (tcpip stand-in) thread
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef HOST_POSIX_LWIP_SOCKETS_H
+#define HOST_POSIX_LWIP_SOCKETS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif
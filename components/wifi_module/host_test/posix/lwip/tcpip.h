@@ -0,0 +1,11 @@
+#ifndef HOST_POSIX_LWIP_TCPIP_H
+#define HOST_POSIX_LWIP_TCPIP_H
+
+#include "lwip/dns.h"
+
+typedef void (*tcpip_callback_fn)(void *ctx);
+
+// Runs fn on a thread of its own, standing in for lwIP's tcpip thread
+err_t tcpip_callback(tcpip_callback_fn fn, void *ctx);
+
+#endif
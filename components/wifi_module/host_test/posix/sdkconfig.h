@@ -0,0 +1 @@
+/* Empty: the host build has no Kconfig */
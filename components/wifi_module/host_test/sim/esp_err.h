@@ -0,0 +1,37 @@
+#ifndef SIM_ESP_ERR_H
+#define SIM_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK                      0
+#define ESP_FAIL                    -1
+#define ESP_ERR_NO_MEM              0x101
+#define ESP_ERR_INVALID_ARG         0x102
+#define ESP_ERR_INVALID_STATE       0x103
+#define ESP_ERR_INVALID_SIZE        0x104
+#define ESP_ERR_NOT_FOUND           0x105
+#define ESP_ERR_TIMEOUT             0x107
+#define ESP_ERR_INVALID_CRC         0x109
+
+#define ESP_ERR_NVS_NOT_FOUND       0x1102
+#define ESP_ERR_NVS_INVALID_LENGTH  0x110c
+#define ESP_ERR_NVS_NO_FREE_PAGES   0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1110
+
+#define ESP_ERR_WIFI_NOT_INIT       0x3001
+#define ESP_ERR_WIFI_NOT_STARTED    0x3002
+#define ESP_ERR_WIFI_NOT_CONNECT    0x300f
+#define ESP_ERR_WIFI_STATE          0x3007
+
+const char *esp_err_to_name(esp_err_t err);
+
+// An ESP_ERROR_CHECK failure aborts the device; the simulator ends the run as failed
+void sim_error_check_failed(esp_err_t err, const char *expr, const char *file, int line);
+#define ESP_ERROR_CHECK(x) do { \
+        esp_err_t err_rc_ = (x); \
+        if (err_rc_ != ESP_OK) { \
+            sim_error_check_failed(err_rc_, #x, __FILE__, __LINE__); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef SIM_ESP_LOG_H
+#define SIM_ESP_LOG_H
+
+// Printed with the simulated time when the runner is started with --verbose, dropped otherwise
+void sim_log(char level, const char *tag, const char *fmt, ...);
+
+#define ESP_LOGE(tag, fmt, ...) sim_log('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) sim_log('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) sim_log('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) do { } while (0)
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef SIM_ESP_RANDOM_H
+#define SIM_ESP_RANDOM_H
+
+#include <stdint.h>
+
+// Drawn from the run's seed, so a run replays exactly
+uint32_t esp_random(void);
+
+#endif
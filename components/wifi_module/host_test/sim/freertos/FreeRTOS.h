@@ -0,0 +1,39 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+/*
+ * FreeRTOS as the simulator provides it: tasks take turns one at a time (see sim_rtos.c), a tick
+ * is one simulated millisecond and nothing takes time unless it blocks. With a single task running
+ * at any moment, critical sections have nothing to exclude.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+typedef uint32_t EventBits_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  0
+#define pdPASS                  1
+#define portMAX_DELAY           UINT32_MAX
+#define portNUM_PROCESSORS      2
+#define tskNO_AFFINITY          0x7fffffff
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+
+#define BIT0    0x00000001
+#define BIT1    0x00000002
+#define BIT2    0x00000004
+#define BIT3    0x00000008
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef SIM_TIMERS_H
+#define SIM_TIMERS_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_rtos_timer StaticTimer_t;
+typedef StaticTimer_t *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+struct sim_rtos_timer {
+    struct sim_timer *timer;
+    TimerCallbackFunction_t cb;
+    TickType_t period;
+    bool auto_reload;
+    void *id;
+};
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t cb);
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                                 TimerCallbackFunction_t cb, StaticTimer_t *storage);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+
+#endif
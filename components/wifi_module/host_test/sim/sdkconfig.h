@@ -0,0 +1 @@
+/* Empty: the simulator has no Kconfig */
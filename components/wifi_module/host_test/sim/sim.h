@@ -0,0 +1,140 @@
+#ifndef SIM_H
+#define SIM_H
+
+/*
+ * Shared between the simulator's mock layers and the scenario runner.
+ *
+ * One run is a sequence of boots. Each boot is a forked child process, so the firmware's static
+ * state starts clean after esp_restart() exactly as it would on the device. What outlives a
+ * reboot (the simulated clock, NVS, the APs and the scenario's metrics) is kept in sim_world,
+ * which sits in memory shared with the runner.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_MAX_APS           4
+#define SIM_MAX_ACTIONS       8
+#define SIM_MAX_PASSWORDS     3
+#define SIM_NVS_ENTRIES       8
+#define SIM_NVS_VALUE_MAX     512
+
+// Reset to app_main: ROM, bootloader and image load
+#define SIM_BOOT_US           350000
+// A run that reboots more often than this is reported as a reboot loop
+#define SIM_MAX_BOOTS         8
+
+// Exit status of a boot that ended in esp_restart()
+#define SIM_EXIT_RESTART      3
+
+typedef struct {
+    char ssid[33];
+    char password[65];      // empty for an open network
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+    bool up;
+} sim_ap_t;
+
+typedef enum {
+    SIM_ACTION_AP_DOWN,     // AP stops beaconing; a connected STA notices after the beacon timeout
+    SIM_ACTION_AP_UP,       // AP is back; time-to-IP is measured from here
+    SIM_ACTION_KICK,        // AP deauthenticates the STA but stays up; time-to-IP is measured from here
+} sim_action_type_t;
+
+typedef struct {
+    int64_t at_us;          // world time
+    sim_action_type_t type;
+    int ap;
+    bool fired;
+} sim_action_t;
+
+typedef struct {
+    bool used;
+    bool is_str;
+    char ns[16];
+    char key[16];
+    uint32_t len;
+    uint8_t value[SIM_NVS_VALUE_MAX];
+} sim_nvs_entry_t;
+
+typedef struct {
+    // Clock and randomness
+    int64_t now_us;             // world time, continues across reboots
+    int64_t boot_us;            // world time this boot started (esp_timer_get_time() counts from here)
+    int64_t horizon_us;         // the run ends here at the latest
+    uint64_t rng;
+
+    sim_ap_t aps[SIM_MAX_APS];
+    int ap_count;
+    sim_action_t actions[SIM_MAX_ACTIONS];
+    int action_count;
+    sim_nvs_entry_t nvs[SIM_NVS_ENTRIES];
+
+    // The person at the portal: submits each password in turn, waiting for the result in between
+    char user_ssid[33];
+    char user_passwords[SIM_MAX_PASSWORDS][65];
+    int user_password_count;
+    int user_next;
+    bool user_waiting;
+    uint32_t user_think_min_ms;
+    uint32_t user_think_max_ms;
+
+    // Fault injection: STA config changes the driver refuses during a live apply
+    int refuse_apply_configs;
+
+    // Metrics
+    int64_t ref_us;             // time-to-IP is measured from here
+    int64_t ip_us;              // first IP at or after ref_us, -1 while there is none
+    int64_t portal_open_us;     // -1 while the portal is closed
+    int64_t portal_total_us;
+    int reboots;
+    uint32_t nvs_commits;
+    bool failed;
+    char error[160];
+} sim_world_t;
+
+extern sim_world_t *sim_world;
+
+uint32_t sim_rand(void);
+// Uniform in [lo, hi]
+uint32_t sim_rand_range(uint32_t lo, uint32_t hi);
+
+// ---- Scheduler (sim_rtos.c) ----
+
+typedef void (*sim_timer_cb_t)(void *arg);
+typedef struct sim_timer sim_timer_t;
+
+// Timer callbacks run between tasks and must not block
+sim_timer_t *sim_timer_new(sim_timer_cb_t cb, void *arg);
+void sim_timer_start(sim_timer_t *timer, int64_t delay_us, int64_t period_us);
+void sim_timer_stop(sim_timer_t *timer);
+bool sim_timer_active(const sim_timer_t *timer);
+void sim_timer_free(sim_timer_t *timer);
+
+/**
+ * @brief Run one boot: app_main on its own task, then every task and timer until the scenario is
+ *        done, nothing is left to happen, or the horizon passes. Called in the forked child; exits it.
+ */
+void sim_run_boot(void (*app_main)(void)) __attribute__((noreturn));
+
+// Mark the run failed and end this boot
+void sim_fail(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+extern bool sim_verbose;
+
+// ---- Mock WiFi driver (sim_wifi.c) ----
+
+// Arm this boot's pending world actions
+void sim_wifi_boot(void);
+
+// ---- Scenario hooks (sim_main.c) ----
+
+void sim_portal_opened(void);
+void sim_portal_closed(void);
+void sim_got_ip(void);
+// Called before the boot ends in esp_restart()
+void sim_before_restart(void);
+bool sim_scenario_done(void);
+
+#endif
@@ -0,0 +1,513 @@
+/*
+ * Scenario runner for the wifi_module state machine.
+ *
+ *   sim_wifi_module [--seeds N] [--seed FIRST] [--scenario NAME] [--json FILE] [--verbose]
+ *
+ * Every scenario is run once per seed: the seed picks the APs' channels and signal, the driver's
+ * timings, the backoff jitter and when the person at the portal acts. For each scenario the runner
+ * reports time-to-IP (from boot, from the disconnect or outage end, or from the last credential
+ * submission), time the provisioning portal was open, and reboots. It exits non-zero if any run
+ * breaks its scenario's expectations, and prints the seed to replay with --verbose.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "esp_wifi.h"
+#include "wifi_module.h"
+#include "wifi_storage.h"
+#include "prov_worker.h"
+#include "sim.h"
+
+#define DEFAULT_SEEDS       1000
+#define USER_POLL_MS        500
+#define MAX_REPORTED_FAILS  5
+
+static const char *HOME_SSID = "home";
+static const char *HOME_PASS = "correct horse";
+static const char *OFFICE_SSID = "office";
+static const char *OFFICE_PASS = "battery staple";
+
+sim_world_t *sim_world;
+
+typedef struct {
+    const char *name;
+    const char *what;
+    void (*setup)(void);
+    int64_t horizon_s;
+    bool want_ip;
+    double max_ip_s;            // bound on time-to-IP
+    double max_portal_s;        // bound on time the portal was open
+    int reboots;                // exact number expected
+} scenario_t;
+
+// ---- Randomness ----
+
+uint32_t sim_rand(void) {
+    // splitmix64
+    uint64_t z = (sim_world->rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+uint32_t sim_rand_range(uint32_t lo, uint32_t hi) {
+    return lo + sim_rand() % (hi - lo + 1);
+}
+
+// ---- Hooks called by the mocks ----
+
+static sim_timer_t *s_user_timer = NULL;
+
+static void user_act(void *arg) {
+    (void)arg;
+    sim_world_t *w = sim_world;
+    prov_status_t status;
+
+    if (w->portal_open_us < 0) {
+        return;
+    }
+    if (w->user_waiting) {
+        prov_worker_get_status(&status);
+        if (status.state == PROV_STATE_FAILED) {
+            w->user_waiting = false;
+            if (w->user_next < w->user_password_count) {
+                sim_timer_start(s_user_timer, (int64_t)sim_rand_range(w->user_think_min_ms, w->user_think_max_ms) * 1000, 0);
+            }
+        } else if (status.state == PROV_STATE_CONNECTED) {
+            w->user_waiting = false;
+        } else {
+            sim_timer_start(s_user_timer, USER_POLL_MS * 1000, 0);
+        }
+        return;
+    }
+    if (w->user_next < w->user_password_count &&
+        prov_worker_post_credentials(PROV_SOURCE_WEB, w->user_ssid, w->user_passwords[w->user_next], NULL) == ESP_OK) {
+        w->user_next++;
+        w->user_waiting = true;
+        w->ref_us = w->now_us;
+        w->ip_us = -1;
+    }
+    sim_timer_start(s_user_timer, USER_POLL_MS * 1000, 0);
+}
+
+void sim_portal_opened(void) {
+    sim_world_t *w = sim_world;
+    if (w->portal_open_us < 0) {
+        w->portal_open_us = w->now_us;
+    }
+    if (w->user_next < w->user_password_count && !w->user_waiting) {
+        if (s_user_timer == NULL) {
+            s_user_timer = sim_timer_new(user_act, NULL);
+        }
+        sim_timer_start(s_user_timer, (int64_t)sim_rand_range(w->user_think_min_ms, w->user_think_max_ms) * 1000, 0);
+    }
+}
+
+void sim_portal_closed(void) {
+    sim_world_t *w = sim_world;
+    if (w->portal_open_us >= 0) {
+        w->portal_total_us += w->now_us - w->portal_open_us;
+        w->portal_open_us = -1;
+    }
+}
+
+void sim_got_ip(void) {
+    if (sim_world->ip_us < 0 && sim_world->now_us >= sim_world->ref_us) {
+        sim_world->ip_us = sim_world->now_us;
+    }
+}
+
+void sim_before_restart(void) {
+    sim_portal_closed();
+    sim_world->user_waiting = false;
+}
+
+bool sim_scenario_done(void) {
+    const sim_world_t *w = sim_world;
+    for (int i = 0; i < w->action_count; i++) {
+        if (!w->actions[i].fired) {
+            return false;
+        }
+    }
+    return w->ip_us >= 0 && w->portal_open_us < 0 && !w->user_waiting && w->user_next == w->user_password_count;
+}
+
+// ---- Scenario building blocks ----
+
+static int add_ap(const char *ssid, const char *password) {
+    sim_ap_t *ap = &sim_world->aps[sim_world->ap_count];
+    snprintf(ap->ssid, sizeof(ap->ssid), "%s", ssid);
+    snprintf(ap->password, sizeof(ap->password), "%s", password);
+    for (int i = 0; i < 6; i++) {
+        ap->bssid[i] = (uint8_t)sim_rand();
+    }
+    ap->channel = (uint8_t)sim_rand_range(1, 11);
+    ap->rssi = (int8_t)-(int)sim_rand_range(45, 80);
+    ap->up = true;
+    return sim_world->ap_count++;
+}
+
+// Remember a network as a previous boot would have; with hint_ap >= 0 it also carries the fast-connect hint
+static void remember(const char *ssid, const char *password, int hint_ap) {
+    wifi_cred_table_t table;
+    if (wifi_storage_load(&table) != ESP_OK) {
+        memset(&table, 0, sizeof(table));
+    }
+    wifi_cred_entry_t *entry = wifi_storage_add(&table, ssid);
+    wifi_storage_mark_success(&table, entry);
+    entry->secret_len = strlen(password);
+    memcpy(entry->secret, password, entry->secret_len);
+    if (hint_ap >= 0) {
+        const sim_ap_t *ap = &sim_world->aps[hint_ap];
+        memcpy(entry->bssid, ap->bssid, sizeof(entry->bssid));
+        entry->channel = ap->channel;
+        entry->authmode = WIFI_AUTH_WPA2_PSK;
+        entry->flags |= WIFI_CRED_F_FAST_VALID;
+    }
+    wifi_storage_save(&table);
+    sim_world->nvs_commits = 0;
+}
+
+static void add_action(int64_t at_ms, sim_action_type_t type, int ap) {
+    sim_action_t *action = &sim_world->actions[sim_world->action_count++];
+    action->at_us = at_ms * 1000;
+    action->type = type;
+    action->ap = ap;
+}
+
+static void user_will_submit(const char *ssid, const char *first, const char *second) {
+    sim_world_t *w = sim_world;
+    snprintf(w->user_ssid, sizeof(w->user_ssid), "%s", ssid);
+    snprintf(w->user_passwords[w->user_password_count++], sizeof(w->user_passwords[0]), "%s", first);
+    if (second != NULL) {
+        snprintf(w->user_passwords[w->user_password_count++], sizeof(w->user_passwords[0]), "%s", second);
+    }
+    w->user_think_min_ms = 10000;
+    w->user_think_max_ms = 45000;
+}
+
+// ---- Scenarios ----
+
+static void setup_boot_fast(void) {
+    int home = add_ap(HOME_SSID, HOME_PASS);
+    add_ap(OFFICE_SSID, OFFICE_PASS);
+    remember(HOME_SSID, HOME_PASS, home);
+}
+
+static void setup_boot_moved_ap(void) {
+    // The hint points at the old router; the new one has another BSSID and channel
+    int home = add_ap(HOME_SSID, HOME_PASS);
+    remember(HOME_SSID, HOME_PASS, home);
+    sim_ap_t *ap = &sim_world->aps[home];
+    ap->bssid[5] ^= 0x01;
+    ap->channel = ap->channel % 11 + 1;
+}
+
+static void setup_boot_other_network(void) {
+    // The network joined last is out of range; the other remembered one is found by the scan
+    int home = add_ap(HOME_SSID, HOME_PASS);
+    add_ap(OFFICE_SSID, OFFICE_PASS);
+    remember(OFFICE_SSID, OFFICE_PASS, -1);
+    remember(HOME_SSID, HOME_PASS, home);
+    sim_world->aps[home].up = false;
+}
+
+static void setup_disconnect(void) {
+    setup_boot_fast();
+    add_action(sim_rand_range(20000, 40000), SIM_ACTION_KICK, 0);
+}
+
+static void setup_router_outage(void) {
+    int64_t down_ms = sim_rand_range(20000, 40000);
+    setup_boot_fast();
+    add_action(down_ms, SIM_ACTION_AP_DOWN, 0);
+    add_action(down_ms + sim_rand_range(30000, 600000), SIM_ACTION_AP_UP, 0);
+}
+
+static void setup_provisioning(void) {
+    add_ap(HOME_SSID, HOME_PASS);
+    add_ap(OFFICE_SSID, OFFICE_PASS);
+    user_will_submit(HOME_SSID, HOME_PASS, NULL);
+}
+
+static void setup_provisioning_retry(void) {
+    add_ap(HOME_SSID, HOME_PASS);
+    user_will_submit(HOME_SSID, "correct h0rse", HOME_PASS);
+}
+
+static void setup_apply_restart(void) {
+    // The driver won't take the new config live, so the worker falls back to a restart
+    add_ap(HOME_SSID, HOME_PASS);
+    user_will_submit(HOME_SSID, HOME_PASS, NULL);
+    sim_world->refuse_apply_configs = 1;
+}
+
+static void setup_portal_timeout(void) {
+    // Nobody provisions the device: the portal closes when the provisioning window ends
+    add_ap(HOME_SSID, HOME_PASS);
+}
+
+// Bounds follow from the design: a fast connect needs no scan; a reconnect waits at most one
+// backoff (WIFI_BACKOFF_MAX_MS) before its scan; the portal window is one minute per attempt.
+static const scenario_t s_scenarios[] = {
+    { "boot_fast", "saved network with a valid fast-connect hint",
+      setup_boot_fast, 60, true, 3.0, 0, 0 },
+    { "boot_moved_ap", "fast-connect hint points at a replaced router",
+      setup_boot_moved_ap, 60, true, 8.0, 0, 0 },
+    { "boot_other_network", "last network gone, another saved one in range",
+      setup_boot_other_network, 60, true, 8.0, 0, 0 },
+    { "disconnect", "AP deauthenticates the STA once",
+      setup_disconnect, 120, true, 10.0, 0, 0 },
+    { "router_outage", "AP off the air for 30 s to 10 min",
+      setup_router_outage, 900, true, 75.0, 130.0, 0 },
+    { "provisioning", "no saved network, credentials entered in the portal",
+      setup_provisioning, 300, true, 10.0, 70.0, 0 },
+    { "provisioning_retry", "wrong passphrase first, then the right one",
+      setup_provisioning_retry, 300, true, 10.0, 130.0, 0 },
+    { "apply_restart", "live apply refused, restart fallback",
+      setup_apply_restart, 300, true, 15.0, 70.0, 1 },
+    { "portal_timeout", "no saved network and nobody provisions",
+      setup_portal_timeout, 300, false, 0, 61.0, 0 },
+};
+#define SCENARIO_COUNT (sizeof(s_scenarios) / sizeof(s_scenarios[0]))
+
+// ---- Runner ----
+
+typedef struct {
+    double ip_s;                // -1 without an IP
+    double portal_s;
+    int reboots;
+    uint32_t nvs_commits;
+    char error[200];            // empty if the run met every expectation
+} run_result_t;
+
+static void sim_app_main(void) {
+    // As main/main.c does
+    wifi_module_init();
+}
+
+static void run_once(const scenario_t *sc, uint32_t seed, run_result_t *out) {
+    sim_world_t *w = sim_world;
+
+    memset(w, 0, sizeof(*w));
+    w->rng = seed * 0x2545f4914f6cdd1dull + 1;
+    w->ip_us = -1;
+    w->portal_open_us = -1;
+    w->horizon_us = sc->horizon_s * 1000000;
+    sc->setup();
+
+    memset(out, 0, sizeof(*out));
+    while (1) {
+        w->boot_us = w->now_us;
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            sim_run_boot(sim_app_main);
+        }
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+            snprintf(out->error, sizeof(out->error), "could not run a boot");
+            return;
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) == SIM_EXIT_RESTART) {
+            if (w->reboots >= SIM_MAX_BOOTS) {
+                snprintf(w->error, sizeof(w->error), "reboot loop: %d reboots", w->reboots);
+                w->failed = true;
+                break;
+            }
+            continue;
+        }
+        if (WIFSIGNALED(status)) {
+            snprintf(w->error, sizeof(w->error), "boot crashed with signal %d", WTERMSIG(status));
+            w->failed = true;
+        } else if (!w->failed && WEXITSTATUS(status) != 0) {
+            snprintf(w->error, sizeof(w->error), "boot exited with status %d", WEXITSTATUS(status));
+            w->failed = true;
+        }
+        break;
+    }
+    sim_portal_closed();
+
+    out->ip_s = w->ip_us >= 0 ? (w->ip_us - w->ref_us) / 1e6 : -1;
+    out->portal_s = w->portal_total_us / 1e6;
+    out->reboots = w->reboots;
+    out->nvs_commits = w->nvs_commits;
+
+    if (w->failed) {
+        snprintf(out->error, sizeof(out->error), "%s", w->error);
+    } else if (sc->want_ip && out->ip_s < 0) {
+        snprintf(out->error, sizeof(out->error), "no IP within %lld s", (long long)sc->horizon_s);
+    } else if (!sc->want_ip && out->ip_s >= 0) {
+        snprintf(out->error, sizeof(out->error), "got an IP without credentials");
+    } else if (out->ip_s > sc->max_ip_s) {
+        snprintf(out->error, sizeof(out->error), "time-to-IP %.2f s over the %.1f s bound", out->ip_s, sc->max_ip_s);
+    } else if (out->portal_s > sc->max_portal_s) {
+        snprintf(out->error, sizeof(out->error), "portal open %.1f s, over the %.1f s bound", out->portal_s,
+                 sc->max_portal_s);
+    } else if (out->reboots != sc->reboots) {
+        snprintf(out->error, sizeof(out->error), "%d reboots, expected %d", out->reboots, sc->reboots);
+    }
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, as tools/stats.py computes it; values must be sorted
+static double percentile(const double *values, int n, double pct) {
+    if (n == 0) {
+        return NAN;
+    }
+    int rank = (int)ceil(pct / 100.0 * n) - 1;
+    rank = rank < 0 ? 0 : (rank >= n ? n - 1 : rank);
+    return values[rank];
+}
+
+typedef struct {
+    int runs;
+    int failures;
+    int with_ip;
+    double ip_p50, ip_p90, ip_max;
+    double portal_p50, portal_max;
+    int reboots;
+    double nvs_commits_mean;
+} summary_t;
+
+static int run_scenario(const scenario_t *sc, uint32_t first_seed, int seeds, summary_t *sum) {
+    double *ip = calloc(seeds, sizeof(double));
+    double *portal = calloc(seeds, sizeof(double));
+    uint64_t commits = 0;
+    run_result_t r;
+
+    memset(sum, 0, sizeof(*sum));
+    for (int i = 0; i < seeds; i++) {
+        uint32_t seed = first_seed + i;
+        run_once(sc, seed, &r);
+        sum->runs++;
+        if (r.ip_s >= 0) {
+            ip[sum->with_ip++] = r.ip_s;
+        }
+        portal[i] = r.portal_s;
+        sum->reboots += r.reboots;
+        commits += r.nvs_commits;
+        if (r.error[0] != '\0') {
+            if (sum->failures++ < MAX_REPORTED_FAILS) {
+                printf("  FAIL %s seed %u: %s\n    replay: sim_wifi_module --scenario %s --seed %u --seeds 1 --verbose\n",
+                       sc->name, seed, r.error, sc->name, seed);
+            }
+        }
+    }
+    qsort(ip, sum->with_ip, sizeof(double), cmp_double);
+    qsort(portal, seeds, sizeof(double), cmp_double);
+    sum->ip_p50 = percentile(ip, sum->with_ip, 50);
+    sum->ip_p90 = percentile(ip, sum->with_ip, 90);
+    sum->ip_max = percentile(ip, sum->with_ip, 100);
+    sum->portal_p50 = percentile(portal, seeds, 50);
+    sum->portal_max = percentile(portal, seeds, 100);
+    sum->nvs_commits_mean = seeds > 0 ? (double)commits / seeds : 0;
+    free(ip);
+    free(portal);
+    return sum->failures;
+}
+
+static void json_number(FILE *f, const char *key, double value, const char *sep) {
+    if (isnan(value)) {
+        fprintf(f, "\"%s\": null%s", key, sep);
+    } else {
+        fprintf(f, "\"%s\": %.3f%s", key, value, sep);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--seeds N] [--seed FIRST] [--scenario NAME] [--json FILE] [--verbose]\n", prog);
+    fprintf(stderr, "scenarios:\n");
+    for (size_t i = 0; i < SCENARIO_COUNT; i++) {
+        fprintf(stderr, "  %-20s %s\n", s_scenarios[i].name, s_scenarios[i].what);
+    }
+}
+
+int main(int argc, char **argv) {
+    int seeds = DEFAULT_SEEDS;
+    uint32_t first_seed = 1;
+    const char *only = NULL;
+    const char *json_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+            seeds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            first_seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            sim_verbose = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (seeds < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    sim_world = mmap(NULL, sizeof(sim_world_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sim_world == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    FILE *json = NULL;
+    if (json_path != NULL && (json = fopen(json_path, "w")) == NULL) {
+        perror(json_path);
+        return 1;
+    }
+    if (json != NULL) {
+        fprintf(json, "{\n  \"seeds\": %d,\n  \"first_seed\": %u,\n  \"scenarios\": {", seeds, first_seed);
+    }
+
+    int failures = 0;
+    bool first = true;
+    printf("%-20s %5s %5s  %-25s  %-17s %7s %6s\n", "scenario", "runs", "fail", "time-to-IP s p50/p90/max",
+           "portal s p50/max", "reboots", "writes");
+    for (size_t i = 0; i < SCENARIO_COUNT; i++) {
+        const scenario_t *sc = &s_scenarios[i];
+        summary_t sum;
+        if (only != NULL && strcmp(only, sc->name) != 0) {
+            continue;
+        }
+        failures += run_scenario(sc, first_seed, seeds, &sum);
+        printf("%-20s %5d %5d  %7.2f %7.2f %7.2f    %7.1f %7.1f   %7d %6.1f\n", sc->name, sum.runs, sum.failures,
+               sum.ip_p50, sum.ip_p90, sum.ip_max, sum.portal_p50, sum.portal_max, sum.reboots,
+               sum.nvs_commits_mean);
+        if (json != NULL) {
+            fprintf(json, "%s\n    \"%s\": {\"runs\": %d, \"failures\": %d, \"with_ip\": %d, ", first ? "" : ",",
+                    sc->name, sum.runs, sum.failures, sum.with_ip);
+            json_number(json, "time_to_ip_p50_s", sum.ip_p50, ", ");
+            json_number(json, "time_to_ip_p90_s", sum.ip_p90, ", ");
+            json_number(json, "time_to_ip_max_s", sum.ip_max, ", ");
+            json_number(json, "portal_p50_s", sum.portal_p50, ", ");
+            json_number(json, "portal_max_s", sum.portal_max, ", ");
+            fprintf(json, "\"reboots\": %d, ", sum.reboots);
+            json_number(json, "nvs_commits_mean", sum.nvs_commits_mean, "}");
+        }
+        first = false;
+    }
+    if (json != NULL) {
+        fprintf(json, "\n  }\n}\n");
+        fclose(json);
+    }
+    if (first) {
+        usage(argv[0]);
+        return 2;
+    }
+    printf("%s\n", failures == 0 ? "all scenarios within bounds" : "some runs broke their scenario's bounds");
+    return failures == 0 ? 0 : 1;
+}
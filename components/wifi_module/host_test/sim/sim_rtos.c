@@ -0,0 +1,613 @@
+/*
+ * FreeRTOS, esp_timer and the default event loop on a simulated clock.
+ *
+ * Every task is a thread, but only one of them runs at a time: the controller (the boot's main
+ * thread) hands a baton to one task and waits until that task blocks. Blocking primitives
+ * record what would wake the task (a condition, a deadline or both) and hand the baton back.
+ * When no task can run, the controller moves the clock to the next deadline and fires the
+ * timers due by then. So code takes no simulated time, only waits do, and a run depends on
+ * nothing but its seed.
+ */
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+// Task switches allowed without the clock moving before the run is reported as a livelock
+#define SIM_MAX_SWITCHES_PER_INSTANT 100000
+// IDF's default event loop queue
+#define SIM_EVENT_QUEUE_LEN          32
+#define SIM_EVENT_HANDLERS_MAX       16
+#define SIM_EVENT_TASK_PRIORITY      20
+
+typedef enum {
+    TASK_READY,
+    TASK_BLOCKED,
+    TASK_DONE,
+} task_state_t;
+
+typedef bool (*wait_cond_t)(void *ctx);
+
+struct sim_task {
+    pthread_t thread;
+    pthread_cond_t cond;
+    const char *name;
+    TaskFunction_t fn;
+    void *param;
+    UBaseType_t priority;
+    task_state_t state;
+    wait_cond_t wait_cond;          // NULL: only the deadline wakes it
+    void *wait_ctx;
+    int64_t wake_us;                // INT64_MAX: no deadline
+    bool timed_out;
+    uint32_t notify;
+    uint64_t last_run;
+    struct sim_task *next;
+};
+
+struct sim_timer {
+    sim_timer_cb_t cb;
+    void *arg;
+    bool active;
+    int64_t expiry_us;
+    int64_t period_us;
+    uint64_t seq;                   // orders timers due at the same instant by when they were armed
+    struct sim_timer *next;
+};
+
+bool sim_verbose = false;
+
+static pthread_mutex_t s_baton = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_controller_cond = PTHREAD_COND_INITIALIZER;
+static struct sim_task *s_tasks = NULL;
+static struct sim_task *s_running = NULL;      // NULL while the controller has the baton
+static __thread struct sim_task *s_self = NULL;
+static struct sim_timer *s_timers = NULL;
+static uint64_t s_switches = 0;
+static uint64_t s_timer_seq = 0;
+
+void sim_log(char level, const char *tag, const char *fmt, ...) {
+    if (!sim_verbose) {
+        return;
+    }
+    va_list args;
+    printf("%10.3f %c %-12s ", sim_world->now_us / 1e6, level, tag);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    putchar('\n');
+}
+
+void sim_fail(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(sim_world->error, sizeof(sim_world->error), fmt, args);
+    va_end(args);
+    sim_world->failed = true;
+    fflush(stdout);
+    _exit(1);
+}
+
+void sim_error_check_failed(esp_err_t err, const char *expr, const char *file, int line) {
+    sim_fail("ESP_ERROR_CHECK(%s) failed with %s at %s:%d", expr, esp_err_to_name(err), file, line);
+}
+
+// ---- Baton passing ----
+
+// Hand the baton back to the controller and sleep until it is ours again
+static void yield_to_controller(struct sim_task *task) {
+    s_running = NULL;
+    pthread_cond_signal(&s_controller_cond);
+    while (s_running != task) {
+        pthread_cond_wait(&task->cond, &s_baton);
+    }
+}
+
+static void run_task(struct sim_task *task) {
+    task->last_run = ++s_switches;
+    s_running = task;
+    pthread_cond_signal(&task->cond);
+    while (s_running != NULL) {
+        pthread_cond_wait(&s_controller_cond, &s_baton);
+    }
+}
+
+static void finish_task(struct sim_task *task) {
+    task->state = TASK_DONE;
+    s_running = NULL;
+    pthread_cond_signal(&s_controller_cond);
+    pthread_mutex_unlock(&s_baton);
+    pthread_exit(NULL);
+}
+
+static void *task_main(void *arg) {
+    struct sim_task *task = arg;
+    pthread_mutex_lock(&s_baton);
+    s_self = task;
+    while (s_running != task) {
+        pthread_cond_wait(&task->cond, &s_baton);
+    }
+    task->fn(task->param);
+    finish_task(task);
+    return NULL;
+}
+
+/**
+ * Block the calling task until cond(ctx) holds or ticks pass.
+ * @return true if the condition holds, false on timeout.
+ */
+static bool wait_until(wait_cond_t cond, void *ctx, TickType_t ticks) {
+    struct sim_task *task = s_self;
+
+    if (cond != NULL && cond(ctx)) {
+        return true;
+    }
+    if (ticks == 0) {
+        return false;
+    }
+    if (task == NULL) {
+        sim_fail("blocking call from a timer callback");
+    }
+    task->wait_cond = cond;
+    task->wait_ctx = ctx;
+    task->wake_us = ticks == portMAX_DELAY ? INT64_MAX : sim_world->now_us + (int64_t)ticks * 1000;
+    task->timed_out = false;
+    task->state = TASK_BLOCKED;
+    yield_to_controller(task);
+    return !task->timed_out;
+}
+
+// Highest priority task that can run; among equals, the one that waited longest
+static struct sim_task *pick_task(void) {
+    struct sim_task *best = NULL;
+
+    for (struct sim_task *t = s_tasks; t != NULL; t = t->next) {
+        if (t->state == TASK_BLOCKED) {
+            if (t->wait_cond != NULL && t->wait_cond(t->wait_ctx)) {
+                t->timed_out = false;
+            } else if (t->wake_us <= sim_world->now_us) {
+                t->timed_out = true;
+            } else {
+                continue;
+            }
+        } else if (t->state != TASK_READY) {
+            continue;
+        }
+        if (best == NULL || t->priority > best->priority ||
+            (t->priority == best->priority && t->last_run < best->last_run)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+// ---- Timers ----
+
+sim_timer_t *sim_timer_new(sim_timer_cb_t cb, void *arg) {
+    sim_timer_t *timer = calloc(1, sizeof(*timer));
+    timer->cb = cb;
+    timer->arg = arg;
+    timer->next = s_timers;
+    s_timers = timer;
+    return timer;
+}
+
+void sim_timer_start(sim_timer_t *timer, int64_t delay_us, int64_t period_us) {
+    timer->active = true;
+    timer->expiry_us = sim_world->now_us + (delay_us > 0 ? delay_us : 0);
+    timer->period_us = period_us;
+    timer->seq = ++s_timer_seq;
+}
+
+void sim_timer_stop(sim_timer_t *timer) {
+    timer->active = false;
+}
+
+bool sim_timer_active(const sim_timer_t *timer) {
+    return timer->active;
+}
+
+void sim_timer_free(sim_timer_t *timer) {
+    for (sim_timer_t **p = &s_timers; *p != NULL; p = &(*p)->next) {
+        if (*p == timer) {
+            *p = timer->next;
+            free(timer);
+            return;
+        }
+    }
+}
+
+static sim_timer_t *next_timer(void) {
+    sim_timer_t *best = NULL;
+    for (sim_timer_t *t = s_timers; t != NULL; t = t->next) {
+        if (t->active && (best == NULL || t->expiry_us < best->expiry_us ||
+                          (t->expiry_us == best->expiry_us && t->seq < best->seq))) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+static void fire_due_timers(void) {
+    sim_timer_t *t;
+    while ((t = next_timer()) != NULL && t->expiry_us <= sim_world->now_us) {
+        if (t->period_us > 0) {
+            t->expiry_us += t->period_us;
+            t->seq = ++s_timer_seq;
+        } else {
+            t->active = false;
+        }
+        t->cb(t->arg);
+    }
+}
+
+static int64_t next_deadline(void) {
+    int64_t next = INT64_MAX;
+    sim_timer_t *t = next_timer();
+    if (t != NULL) {
+        next = t->expiry_us;
+    }
+    for (struct sim_task *task = s_tasks; task != NULL; task = task->next) {
+        if (task->state == TASK_BLOCKED && task->wake_us < next) {
+            next = task->wake_us;
+        }
+    }
+    return next;
+}
+
+// ---- Controller ----
+
+static void app_main_task(void *param) {
+    ((void (*)(void))param)();
+}
+
+void sim_run_boot(void (*app_main)(void)) {
+    uint64_t switches_at_instant = 0;
+
+    pthread_mutex_lock(&s_baton);
+    sim_wifi_boot();
+    xTaskCreatePinnedToCore(app_main_task, "main", 3584, (void *)app_main, 1, NULL, 0);
+
+    while (!sim_scenario_done()) {
+        fire_due_timers();
+        struct sim_task *task = pick_task();
+        if (task != NULL) {
+            if (++switches_at_instant > SIM_MAX_SWITCHES_PER_INSTANT) {
+                sim_fail("livelock: tasks keep running without the clock moving (last: %s)", task->name);
+            }
+            task->state = TASK_READY;
+            run_task(task);
+            continue;
+        }
+        int64_t next = next_deadline();
+        if (next == INT64_MAX || next > sim_world->horizon_us) {
+            break;
+        }
+        sim_world->now_us = next;
+        switches_at_instant = 0;
+    }
+    fflush(stdout);
+    // The tasks are parked, not finished; nothing of this boot is needed any more
+    _exit(0);
+}
+
+// ---- Tasks ----
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void)stack_depth;
+    (void)core;
+    struct sim_task *task = calloc(1, sizeof(*task));
+    task->name = name;
+    task->fn = fn;
+    task->param = param;
+    task->priority = priority;
+    task->state = TASK_READY;
+    task->wake_us = INT64_MAX;
+    task->last_run = 0;
+    pthread_cond_init(&task->cond, NULL);
+
+    // Appended, so equal-priority tasks that never ran start in creation order
+    struct sim_task **tail = &s_tasks;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = task;
+    if (pthread_create(&task->thread, NULL, task_main, task) != 0) {
+        sim_fail("can't create a thread for task %s", name);
+    }
+    pthread_detach(task->thread);
+    if (handle != NULL) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *param,
+                                           UBaseType_t priority, StackType_t *stack, StaticTask_t *tcb,
+                                           BaseType_t core) {
+    (void)stack;
+    (void)tcb;
+    TaskHandle_t handle = NULL;
+    xTaskCreatePinnedToCore(fn, name, stack_depth, param, priority, &handle, core);
+    return handle;
+}
+
+static bool notified(void *ctx) {
+    return ((struct sim_task *)ctx)->notify > 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    task->notify++;
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct sim_task *task = s_self;
+    if (!wait_until(notified, task, ticks)) {
+        return 0;
+    }
+    uint32_t value = task->notify;
+    task->notify = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    wait_until(NULL, NULL, ticks > 0 ? ticks : 1);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != NULL && task != s_self) {
+        sim_fail("deleting another task is not simulated");
+    }
+    finish_task(s_self);
+}
+
+// ---- Event groups ----
+
+struct sim_event_group {
+    EventBits_t bits;
+};
+
+typedef struct {
+    EventGroupHandle_t group;
+    EventBits_t bits;
+    bool all;
+} bits_wait_t;
+
+static bool bits_set(void *ctx) {
+    bits_wait_t *w = ctx;
+    EventBits_t have = w->group->bits & w->bits;
+    return w->all ? have == w->bits : have != 0;
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    return calloc(1, sizeof(struct sim_event_group));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    group->bits |= bits;
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks) {
+    bits_wait_t w = { .group = group, .bits = bits, .all = wait_for_all };
+    bool met = wait_until(bits_set, &w, ticks);
+    EventBits_t value = group->bits;
+    if (met && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return value;
+}
+
+// ---- Queues ----
+
+static bool queue_has_space(void *ctx) {
+    QueueHandle_t q = ctx;
+    return q->count < q->length;
+}
+
+static bool queue_has_item(void *ctx) {
+    return ((QueueHandle_t)ctx)->count > 0;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *buffer,
+                                 StaticQueue_t *storage) {
+    memset(storage, 0, sizeof(*storage));
+    storage->buf = buffer;
+    storage->length = length;
+    storage->item_size = item_size;
+    return storage;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    if (!wait_until(queue_has_space, queue, ticks)) {
+        return pdFAIL;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->buf + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    if (!wait_until(queue_has_item, queue, ticks)) {
+        return pdFAIL;
+    }
+    memcpy(item, queue->buf + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdPASS;
+}
+
+// ---- FreeRTOS software timers ----
+
+static void rtos_timer_fired(void *arg) {
+    TimerHandle_t timer = arg;
+    timer->cb(timer);
+}
+
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                                 TimerCallbackFunction_t cb, StaticTimer_t *storage) {
+    (void)name;
+    storage->timer = sim_timer_new(rtos_timer_fired, storage);
+    storage->cb = cb;
+    storage->period = period;
+    storage->auto_reload = auto_reload;
+    storage->id = id;
+    return storage;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t cb) {
+    return xTimerCreateStatic(name, period, auto_reload, id, cb, calloc(1, sizeof(StaticTimer_t)));
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks) {
+    (void)ticks;
+    timer->period = period;
+    return xTimerStart(timer, 0);
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks) {
+    (void)ticks;
+    int64_t period_us = (int64_t)timer->period * 1000;
+    sim_timer_start(timer->timer, period_us, timer->auto_reload ? period_us : 0);
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks) {
+    (void)ticks;
+    sim_timer_stop(timer->timer);
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+    return sim_timer_active(timer->timer);
+}
+
+// ---- esp_timer ----
+
+int64_t esp_timer_get_time(void) {
+    return sim_world->now_us - sim_world->boot_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+    *handle = sim_timer_new(args->callback, args->arg);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sim_timer_start(timer, (int64_t)timeout_us, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sim_timer_stop(timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    sim_timer_free(timer);
+    return ESP_OK;
+}
+
+// ---- Default event loop ----
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    void *data;
+} queued_event_t;
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} event_handler_entry_t;
+
+static queued_event_t s_event_buf[SIM_EVENT_QUEUE_LEN];
+static StaticQueue_t s_event_queue_storage;
+static QueueHandle_t s_event_queue = NULL;
+static event_handler_entry_t s_handlers[SIM_EVENT_HANDLERS_MAX];
+static int s_handler_count = 0;
+
+static void event_loop_task(void *param) {
+    (void)param;
+    queued_event_t ev;
+
+    while (1) {
+        xQueueReceive(s_event_queue, &ev, portMAX_DELAY);
+        for (int i = 0; i < s_handler_count; i++) {
+            const event_handler_entry_t *h = &s_handlers[i];
+            if (h->base == ev.base && (h->id == ESP_EVENT_ANY_ID || h->id == ev.id)) {
+                h->handler(h->arg, ev.base, ev.id, ev.data);
+            }
+        }
+        free(ev.data);
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+    if (s_event_queue != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_event_queue = xQueueCreateStatic(SIM_EVENT_QUEUE_LEN, sizeof(queued_event_t), (uint8_t *)s_event_buf,
+                                       &s_event_queue_storage);
+    xTaskCreatePinnedToCore(event_loop_task, "sys_evt", 2304, NULL, SIM_EVENT_TASK_PRIORITY, NULL, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler,
+                                              void *arg, esp_event_handler_instance_t *instance) {
+    if (s_handler_count >= SIM_EVENT_HANDLERS_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_handlers[s_handler_count++] = (event_handler_entry_t){ base, id, handler, arg };
+    if (instance != NULL) {
+        *instance = &s_handlers[s_handler_count - 1];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size, TickType_t ticks) {
+    queued_event_t ev = { .base = base, .id = id };
+
+    if (s_event_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (data != NULL && size > 0) {
+        ev.data = malloc(size);
+        memcpy(ev.data, data, size);
+    }
+    if (xQueueSend(s_event_queue, &ev, ticks) != pdPASS) {
+        free(ev.data);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,90 @@
+/*
+ * The transports and side services wifi_module.c starts and stops. The simulator does not model
+ * them beyond what the scenarios measure: the web server's lifetime is the portal's, and the
+ * connectivity probe answers online right away.
+ */
+#include "esp_event.h"
+#include "ble_provisioning.h"
+#include "captive_dns.h"
+#include "conn_check.h"
+#include "dlog.h"
+#include "res_monitor.h"
+#include "web_server.h"
+#include "sim.h"
+
+void start_webserver(void) {
+    sim_portal_opened();
+}
+
+void stop_webserver(void) {
+    sim_portal_closed();
+}
+
+esp_err_t captive_dns_start(uint32_t ip) {
+    (void)ip;
+    return ESP_OK;
+}
+
+void captive_dns_stop(void) {
+}
+
+void start_ble_provisioning(void) {
+}
+
+void stop_ble_provisioning(void) {
+}
+
+void ble_provisioning_release_memory(void) {
+}
+
+void ble_provisioning_notify_status(ble_prov_status_t status, uint8_t reason, uint32_t ip) {
+    (void)status;
+    (void)reason;
+    (void)ip;
+}
+
+void res_monitor_start(void) {
+}
+
+void res_monitor_stop(void) {
+}
+
+void res_monitor_sample(void) {
+}
+
+void res_monitor_log_report(void) {
+}
+
+esp_err_t dlog_init(void) {
+    return ESP_OK;
+}
+
+void dlog_str(dlog_msg_t msg, const char *str, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    (void)msg;
+    (void)str;
+    (void)a0;
+    (void)a1;
+    (void)a2;
+    (void)a3;
+}
+
+void dlog_time_callback(dlog_cb_t cb, int64_t start_us) {
+    (void)cb;
+    (void)start_us;
+}
+
+ESP_EVENT_DEFINE_BASE(CONN_CHECK_EVENT);
+
+esp_err_t conn_check_init(const conn_check_config_t *config) {
+    (void)config;
+    return ESP_OK;
+}
+
+void conn_check_trigger(bool force) {
+    (void)force;
+    conn_check_result_t result = { .online = true, .dns_ok = true, .timestamp_us = 1 };
+    esp_event_post(CONN_CHECK_EVENT, CONN_CHECK_EVENT_ONLINE, &result, sizeof(result), 0);
+}
+
+void conn_check_invalidate(void) {
+}
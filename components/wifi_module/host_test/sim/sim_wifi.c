@@ -0,0 +1,602 @@
+/*
+ * The WiFi driver, netif, NVS and system calls the firmware makes, against the simulated world.
+ *
+ * The driver is a small timing model of the IDF's STA: a connect searches for the AP (one channel
+ * when the config pins it, all of them otherwise), associates, runs the handshake and then DHCP,
+ * each step taking a random time in a plausible range. Wrong passwords fail the handshake with the
+ * reason the IDF reports, a missing AP fails the search with NO_AP_FOUND, and an AP that goes down
+ * under a connected STA is noticed after the beacon timeout.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "sim.h"
+
+// Driver timing model, ms
+#define DWELL_DEFAULT_MS        120     // per channel when the driver searches for an AP itself
+#define CHANNELS                13
+#define START_MIN_MS            20
+#define START_MAX_MS            60
+#define ASSOC_MIN_MS            40
+#define ASSOC_MAX_MS            150
+#define HANDSHAKE_MIN_MS        30
+#define HANDSHAKE_MAX_MS        120
+#define WRONG_KEY_MIN_MS        1500    // the 4-way handshake times out on a wrong passphrase
+#define WRONG_KEY_MAX_MS        4000
+#define DHCP_MIN_MS             150
+#define DHCP_MAX_MS             1500
+#define BEACON_LOSS_MIN_MS      3000
+#define BEACON_LOSS_MAX_MS      6000
+
+#define SIM_FREE_HEAP           180000
+#define SIM_LARGEST_BLOCK       110000
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+static const char *TAG = "SIM_WIFI";
+
+typedef enum {
+    LINK_IDLE,
+    LINK_SEARCHING,
+    LINK_ASSOCIATING,
+    LINK_HANDSHAKE,
+    LINK_DHCP,
+    LINK_UP,
+} link_state_t;
+
+static struct {
+    bool initialised;
+    bool started;
+    wifi_mode_t mode;
+    wifi_sta_config_t sta;
+    link_state_t link;
+    int ap;                         // AP being joined or joined, -1 for none
+    sim_timer_t *link_timer;
+    sim_timer_t *beacon_timer;
+    sim_timer_t *start_timer;
+    bool scanning;
+    sim_timer_t *scan_timer;
+    wifi_ap_record_t results[SIM_MAX_APS];
+    uint16_t result_count;
+    sim_timer_t *action_timers[SIM_MAX_ACTIONS];
+} s_drv = { .ap = -1 };
+
+static struct sim_netif {
+    int unused;
+} s_sta_netif, s_ap_netif;
+
+static void post(int32_t id, const void *data, size_t size) {
+    if (esp_event_post(WIFI_EVENT, id, data, size, 0) != ESP_OK) {
+        sim_fail("event queue full posting WIFI_EVENT %d", (int)id);
+    }
+}
+
+static void post_disconnected(int ap, uint8_t reason) {
+    wifi_event_sta_disconnected_t ev = { .reason = reason, .rssi = -127 };
+    if (ap >= 0) {
+        const sim_ap_t *a = &sim_world->aps[ap];
+        memcpy(ev.ssid, a->ssid, strlen(a->ssid));
+        ev.ssid_len = strlen(a->ssid);
+        memcpy(ev.bssid, a->bssid, sizeof(ev.bssid));
+    }
+    post(WIFI_EVENT_STA_DISCONNECTED, &ev, sizeof(ev));
+}
+
+// Drop whatever link there is or is being made, without an event
+static void link_reset(void) {
+    sim_timer_stop(s_drv.link_timer);
+    sim_timer_stop(s_drv.beacon_timer);
+    s_drv.link = LINK_IDLE;
+    s_drv.ap = -1;
+}
+
+static bool sta_enabled(void) {
+    return s_drv.mode == WIFI_MODE_STA || s_drv.mode == WIFI_MODE_APSTA;
+}
+
+// The AP a connect with the current config would find, -1 if none is on the air
+static int find_target(void) {
+    int best = -1;
+    for (int i = 0; i < sim_world->ap_count; i++) {
+        const sim_ap_t *a = &sim_world->aps[i];
+        if (!a->up || strncmp(a->ssid, (const char *)s_drv.sta.ssid, sizeof(s_drv.sta.ssid)) != 0) {
+            continue;
+        }
+        if (s_drv.sta.bssid_set && memcmp(a->bssid, s_drv.sta.bssid, sizeof(a->bssid)) != 0) {
+            continue;
+        }
+        if (s_drv.sta.channel != 0 && a->channel != s_drv.sta.channel) {
+            continue;
+        }
+        if (best < 0 || a->rssi > sim_world->aps[best].rssi) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static bool key_matches(const sim_ap_t *ap) {
+    return strncmp(ap->password, (const char *)s_drv.sta.password, sizeof(s_drv.sta.password)) == 0;
+}
+
+static int64_t ms_range(uint32_t lo, uint32_t hi) {
+    return (int64_t)sim_rand_range(lo, hi) * 1000;
+}
+
+static void link_step(void *arg) {
+    (void)arg;
+    const sim_ap_t *ap = s_drv.ap >= 0 ? &sim_world->aps[s_drv.ap] : NULL;
+
+    switch (s_drv.link) {
+    case LINK_SEARCHING:
+        s_drv.ap = find_target();
+        if (s_drv.ap < 0) {
+            link_reset();
+            post_disconnected(-1, WIFI_REASON_NO_AP_FOUND);
+            return;
+        }
+        s_drv.link = LINK_ASSOCIATING;
+        sim_timer_start(s_drv.link_timer, ms_range(ASSOC_MIN_MS, ASSOC_MAX_MS), 0);
+        return;
+    case LINK_ASSOCIATING:
+        if (!ap->up) {
+            int gone = s_drv.ap;
+            link_reset();
+            post_disconnected(gone, WIFI_REASON_CONNECTION_FAIL);
+            return;
+        }
+        s_drv.link = LINK_HANDSHAKE;
+        sim_timer_start(s_drv.link_timer, key_matches(ap) ? ms_range(HANDSHAKE_MIN_MS, HANDSHAKE_MAX_MS)
+                                                          : ms_range(WRONG_KEY_MIN_MS, WRONG_KEY_MAX_MS), 0);
+        return;
+    case LINK_HANDSHAKE:
+        if (!ap->up || !key_matches(ap)) {
+            int failed = s_drv.ap;
+            link_reset();
+            post_disconnected(failed, ap->up ? WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT : WIFI_REASON_BEACON_TIMEOUT);
+            return;
+        }
+        s_drv.link = LINK_DHCP;
+        post(WIFI_EVENT_STA_CONNECTED, NULL, 0);
+        sim_timer_start(s_drv.link_timer, ms_range(DHCP_MIN_MS, DHCP_MAX_MS), 0);
+        return;
+    case LINK_DHCP: {
+        s_drv.link = LINK_UP;
+        ip_event_got_ip_t ev = { .esp_netif = &s_sta_netif };
+        uint8_t *ip = (uint8_t *)&ev.ip_info.ip.addr;
+        ip[0] = 192;
+        ip[1] = 168;
+        ip[2] = 1;
+        ip[3] = 100 + s_drv.ap;
+        if (esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &ev, sizeof(ev), 0) != ESP_OK) {
+            sim_fail("event queue full posting IP_EVENT_STA_GOT_IP");
+        }
+        sim_got_ip();
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+static void beacon_lost(void *arg) {
+    (void)arg;
+    int ap = s_drv.ap;
+    if (s_drv.link == LINK_IDLE || ap < 0 || sim_world->aps[ap].up) {
+        return;
+    }
+    link_reset();
+    post_disconnected(ap, WIFI_REASON_BEACON_TIMEOUT);
+}
+
+static void scan_finished(void *arg) {
+    (void)arg;
+    s_drv.scanning = false;
+    s_drv.result_count = 0;
+    for (int i = 0; i < sim_world->ap_count; i++) {
+        const sim_ap_t *a = &sim_world->aps[i];
+        if (!a->up) {
+            continue;
+        }
+        wifi_ap_record_t *rec = &s_drv.results[s_drv.result_count++];
+        memset(rec, 0, sizeof(*rec));
+        memcpy(rec->ssid, a->ssid, strlen(a->ssid));
+        memcpy(rec->bssid, a->bssid, sizeof(rec->bssid));
+        rec->primary = a->channel;
+        rec->rssi = (int8_t)(a->rssi - 3 + (int)sim_rand_range(0, 6));
+        rec->authmode = a->password[0] != '\0' ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+    }
+    post(WIFI_EVENT_SCAN_DONE, NULL, 0);
+}
+
+static void sta_started(void *arg) {
+    (void)arg;
+    post(WIFI_EVENT_STA_START, NULL, 0);
+}
+
+// ---- World actions ----
+
+static void world_action(void *arg) {
+    sim_action_t *action = arg;
+    sim_ap_t *ap = &sim_world->aps[action->ap];
+
+    action->fired = true;
+    switch (action->type) {
+    case SIM_ACTION_AP_DOWN:
+        ESP_LOGW(TAG, "AP %s goes down", ap->ssid);
+        ap->up = false;
+        if (s_drv.ap == action->ap && s_drv.link == LINK_UP) {
+            sim_timer_start(s_drv.beacon_timer, ms_range(BEACON_LOSS_MIN_MS, BEACON_LOSS_MAX_MS), 0);
+        }
+        break;
+    case SIM_ACTION_AP_UP:
+        ESP_LOGW(TAG, "AP %s is back", ap->ssid);
+        ap->up = true;
+        sim_world->ref_us = sim_world->now_us;
+        sim_world->ip_us = -1;
+        break;
+    case SIM_ACTION_KICK:
+        ESP_LOGW(TAG, "AP %s deauthenticates us", ap->ssid);
+        sim_world->ref_us = sim_world->now_us;
+        sim_world->ip_us = -1;
+        if (s_drv.ap == action->ap && s_drv.link != LINK_IDLE) {
+            link_reset();
+            post_disconnected(action->ap, WIFI_REASON_AUTH_EXPIRE);
+        }
+        break;
+    }
+}
+
+void sim_wifi_boot(void) {
+    s_drv.link_timer = sim_timer_new(link_step, NULL);
+    s_drv.beacon_timer = sim_timer_new(beacon_lost, NULL);
+    s_drv.start_timer = sim_timer_new(sta_started, NULL);
+    s_drv.scan_timer = sim_timer_new(scan_finished, NULL);
+    for (int i = 0; i < sim_world->action_count; i++) {
+        sim_action_t *action = &sim_world->actions[i];
+        if (!action->fired) {
+            s_drv.action_timers[i] = sim_timer_new(world_action, action);
+            sim_timer_start(s_drv.action_timers[i], action->at_us - sim_world->now_us, 0);
+        }
+    }
+}
+
+// ---- esp_wifi ----
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config) {
+    (void)config;
+    s_drv.initialised = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) {
+    if (!s_drv.initialised) {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    if (s_drv.started && sta_enabled() && mode != WIFI_MODE_STA && mode != WIFI_MODE_APSTA &&
+        s_drv.link != LINK_IDLE) {
+        int ap = s_drv.ap;
+        link_reset();
+        post_disconnected(ap, WIFI_REASON_ASSOC_LEAVE);
+    }
+    s_drv.mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf) {
+    if (!s_drv.initialised) {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    if (interface != WIFI_IF_STA) {
+        return ESP_OK;
+    }
+    // Only the live apply asks for an all-channel scan, so this refuses exactly that path
+    if (conf->sta.scan_method == WIFI_ALL_CHANNEL_SCAN && sim_world->refuse_apply_configs > 0) {
+        sim_world->refuse_apply_configs--;
+        ESP_LOGW(TAG, "Refusing the STA config (fault injection)");
+        return ESP_ERR_WIFI_STATE;
+    }
+    s_drv.sta = conf->sta;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+    if (!s_drv.initialised) {
+        return ESP_ERR_WIFI_NOT_INIT;
+    }
+    if (!s_drv.started) {
+        s_drv.started = true;
+        if (sta_enabled()) {
+            sim_timer_start(s_drv.start_timer, ms_range(START_MIN_MS, START_MAX_MS), 0);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void) {
+    if (s_drv.started && s_drv.link != LINK_IDLE) {
+        int ap = s_drv.ap;
+        link_reset();
+        post_disconnected(ap, WIFI_REASON_ASSOC_LEAVE);
+    }
+    sim_timer_stop(s_drv.start_timer);
+    sim_timer_stop(s_drv.scan_timer);
+    s_drv.scanning = false;
+    if (s_drv.started) {
+        s_drv.started = false;
+        post(WIFI_EVENT_STA_STOP, NULL, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void) {
+    if (!s_drv.started || !sta_enabled()) {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    if (s_drv.link != LINK_IDLE) {
+        int ap = s_drv.ap;
+        link_reset();
+        post_disconnected(ap, WIFI_REASON_ASSOC_LEAVE);
+    }
+    // A pinned channel is one dwell; otherwise the driver sweeps every channel
+    int channels = s_drv.sta.channel != 0 ? 1 : CHANNELS;
+    s_drv.link = LINK_SEARCHING;
+    sim_timer_start(s_drv.link_timer, (int64_t)channels * DWELL_DEFAULT_MS * 1000 + ms_range(0, 30), 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void) {
+    if (!s_drv.started) {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    if (s_drv.link != LINK_IDLE) {
+        int ap = s_drv.ap;
+        link_reset();
+        post_disconnected(ap, WIFI_REASON_ASSOC_LEAVE);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block) {
+    if (!s_drv.started || !sta_enabled()) {
+        return ESP_ERR_WIFI_NOT_STARTED;
+    }
+    // As on the IDF: no scanning while a connect is in progress, nor two scans at once
+    if (block || s_drv.scanning || (s_drv.link != LINK_IDLE && s_drv.link != LINK_UP)) {
+        return ESP_ERR_WIFI_STATE;
+    }
+    uint32_t dwell = config->scan_time.active.max > 0 ? config->scan_time.active.max : DWELL_DEFAULT_MS;
+    s_drv.scanning = true;
+    sim_timer_start(s_drv.scan_timer, (int64_t)CHANNELS * dwell * 1000 + ms_range(0, 50), 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_stop(void) {
+    sim_timer_stop(s_drv.scan_timer);
+    s_drv.scanning = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *records) {
+    uint16_t n = *number < s_drv.result_count ? *number : s_drv.result_count;
+    memcpy(records, s_drv.results, n * sizeof(records[0]));
+    *number = n;
+    // The driver hands its list over once
+    s_drv.result_count = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info) {
+    if (s_drv.link < LINK_DHCP || s_drv.ap < 0) {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    const sim_ap_t *a = &sim_world->aps[s_drv.ap];
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->ssid, a->ssid, strlen(a->ssid));
+    memcpy(ap_info->bssid, a->bssid, sizeof(ap_info->bssid));
+    ap_info->primary = a->channel;
+    ap_info->rssi = a->rssi;
+    ap_info->authmode = a->password[0] != '\0' ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+    return ESP_OK;
+}
+
+// ---- esp_netif ----
+
+esp_err_t esp_netif_init(void) {
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void) {
+    return &s_sta_netif;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void) {
+    return &s_ap_netif;
+}
+
+void esp_netif_destroy_default_wifi(void *netif) {
+    (void)netif;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *netif, esp_netif_ip_info_t *ip_info) {
+    memset(ip_info, 0, sizeof(*ip_info));
+    if (netif == &s_ap_netif) {
+        uint8_t *ip = (uint8_t *)&ip_info->ip.addr;
+        ip[0] = 192;
+        ip[1] = 168;
+        ip[2] = 4;
+        ip[3] = 1;
+    }
+    return ESP_OK;
+}
+
+// ---- NVS: one flat table in sim_world, so it survives reboots ----
+
+#define NVS_HANDLES 4
+static char s_open_ns[NVS_HANDLES][16];
+
+static sim_nvs_entry_t *nvs_find(nvs_handle_t handle, const char *key) {
+    for (int i = 0; i < SIM_NVS_ENTRIES; i++) {
+        sim_nvs_entry_t *e = &sim_world->nvs[i];
+        if (e->used && strcmp(e->ns, s_open_ns[handle]) == 0 && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    memset(sim_world->nvs, 0, sizeof(sim_world->nvs));
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle) {
+    (void)mode;
+    for (nvs_handle_t h = 0; h < NVS_HANDLES; h++) {
+        if (s_open_ns[h][0] == '\0') {
+            snprintf(s_open_ns[h], sizeof(s_open_ns[h]), "%s", name);
+            *handle = h;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    s_open_ns[handle][0] = '\0';
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, bool is_str, void *out, size_t *length) {
+    const sim_nvs_entry_t *e = nvs_find(handle, key);
+    if (e == NULL || e->is_str != is_str) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out == NULL) {
+        *length = e->len;
+        return ESP_OK;
+    }
+    if (*length < e->len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out, e->value, e->len);
+    *length = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *length) {
+    return nvs_get(handle, key, false, out, length);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out, size_t *length) {
+    return nvs_get(handle, key, true, out, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    sim_nvs_entry_t *e = nvs_find(handle, key);
+    if (length > SIM_NVS_VALUE_MAX) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    for (int i = 0; e == NULL && i < SIM_NVS_ENTRIES; i++) {
+        if (!sim_world->nvs[i].used) {
+            e = &sim_world->nvs[i];
+            e->used = true;
+            snprintf(e->ns, sizeof(e->ns), "%s", s_open_ns[handle]);
+            snprintf(e->key, sizeof(e->key), "%s", key);
+        }
+    }
+    if (e == NULL) {
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+    e->is_str = false;
+    e->len = length;
+    memcpy(e->value, value, length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    sim_nvs_entry_t *e = nvs_find(handle, key);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    memset(e, 0, sizeof(*e));
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    (void)handle;
+    sim_world->nvs_commits++;
+    return ESP_OK;
+}
+
+// ---- System ----
+
+void esp_restart(void) {
+    ESP_LOGW(TAG, "esp_restart()");
+    sim_before_restart();
+    sim_world->reboots++;
+    sim_world->now_us += SIM_BOOT_US;
+    fflush(stdout);
+    _exit(SIM_EXIT_RESTART);
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return SIM_FREE_HEAP;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return SIM_FREE_HEAP;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    (void)caps;
+    return SIM_LARGEST_BLOCK;
+}
+
+uint32_t esp_random(void) {
+    return sim_rand();
+}
+
+// Same polynomial and conventions as the ROM routine
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+const char *esp_err_to_name(esp_err_t err) {
+    switch (err) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_WIFI_NOT_INIT: return "ESP_ERR_WIFI_NOT_INIT";
+    case ESP_ERR_WIFI_NOT_STARTED: return "ESP_ERR_WIFI_NOT_STARTED";
+    case ESP_ERR_WIFI_NOT_CONNECT: return "ESP_ERR_WIFI_NOT_CONNECT";
+    case ESP_ERR_WIFI_STATE: return "ESP_ERR_WIFI_STATE";
+    default: return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,127 @@
+// ble_provisioning.c's lifecycle against the NimBLE and controller mock in ble/: the portal can close
+// and reopen within one boot, so BLE has to come back after a stop, and only an explicit release of
+// the controller's memory may take it away for good.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ble_provisioning.h"
+#include "boot_trace.h"
+#include "dlog.h"
+#include "prov_worker.h"
+#include "nimble_mock.h"
+#include "test_common.h"
+
+// ---- What ble_provisioning.c needs from the rest of the firmware and the sim/ headers ----
+
+void sim_log(char level, const char *tag, const char *fmt, ...) {
+    (void)level;
+    (void)tag;
+    (void)fmt;
+}
+
+void sim_error_check_failed(esp_err_t err, const char *expr, const char *file, int line) {
+    fprintf(stderr, "%s:%d: ESP_ERROR_CHECK(%s) failed: %d\n", file, line, expr, err);
+    exit(1);
+}
+
+const char *esp_err_to_name(esp_err_t err) {
+    return err == ESP_OK ? "ESP_OK" : "error";
+}
+
+int64_t esp_timer_get_time(void) {
+    return 0;
+}
+
+void boot_trace_mark(boot_trace_stage_t stage, uint32_t arg) {
+    (void)stage;
+    (void)arg;
+}
+
+void dlog_str(dlog_msg_t msg, const char *str, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    (void)msg;
+    (void)str;
+    (void)a0;
+    (void)a1;
+    (void)a2;
+    (void)a3;
+}
+
+void dlog_time_callback(dlog_cb_t cb, int64_t start_us) {
+    (void)cb;
+    (void)start_us;
+}
+
+esp_err_t prov_worker_post_credentials(prov_source_t source, const char *ssid, const char *password,
+                                      const uint8_t *bssid) {
+    (void)source;
+    (void)ssid;
+    (void)password;
+    (void)bssid;
+    return ESP_OK;
+}
+
+// ---- Tests ----
+
+// The portal's teardown stops BLE, and a later failed connection round reopens it
+static void test_stop_start_stop(void) {
+    start_ble_provisioning();
+    CHECK(nimble_mock.port_init == 1);
+    CHECK(nimble_mock.adv_start == 1);
+
+    stop_ble_provisioning();
+    CHECK(nimble_mock.port_deinit == 1);
+    CHECK(nimble_mock.adv_stop == 1);
+    CHECK(!nimble_mock.controller_up);
+    CHECK(nimble_mock.mem_release == 0);
+
+    start_ble_provisioning();
+    CHECK(nimble_mock.port_init == 2);
+    CHECK(nimble_mock.port_init_refused == 0);
+    CHECK(nimble_mock.controller_up);
+    CHECK(nimble_mock.adv_start == 2);
+
+    stop_ble_provisioning();
+    CHECK(nimble_mock.port_deinit == 2);
+    CHECK(nimble_mock.adv_stop == 2);
+    CHECK(nimble_mock.mem_release == 0);
+}
+
+static void test_repeated_calls_are_ignored(void) {
+    stop_ble_provisioning();
+    CHECK(nimble_mock.port_deinit == 2);
+
+    start_ble_provisioning();
+    start_ble_provisioning();
+    CHECK(nimble_mock.port_init == 3);
+    CHECK(nimble_mock.port_init_refused == 0);
+
+    // Never while the controller is in use
+    ble_provisioning_release_memory();
+    CHECK(nimble_mock.mem_release == 0);
+
+    stop_ble_provisioning();
+    CHECK(nimble_mock.port_deinit == 3);
+}
+
+// Once released, start is a logged no-op instead of an abort in nimble_port_init()
+static void test_release_is_final(void) {
+    ble_provisioning_release_memory();
+    CHECK(nimble_mock.mem_release == 1);
+    ble_provisioning_release_memory();
+    CHECK(nimble_mock.mem_release == 1);
+
+    start_ble_provisioning();
+    CHECK(nimble_mock.port_init == 3);
+    CHECK(nimble_mock.port_init_refused == 0);
+    CHECK(!nimble_mock.controller_up);
+
+    stop_ble_provisioning();
+    CHECK(nimble_mock.port_deinit == 3);
+}
+
+int main(void) {
+    test_stop_start_stop();
+    test_repeated_calls_are_ignored();
+    test_release_is_final();
+    return TEST_EXIT();
+}
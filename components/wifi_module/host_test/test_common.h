@@ -0,0 +1,18 @@
+#ifndef HOST_TEST_COMMON_H
+#define HOST_TEST_COMMON_H
+
+#include <stdio.h>
+
+// Each test binary counts failed checks and exits non-zero if there were any
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_EXIT() (test_failures == 0 ? (printf("all checks passed\n"), 0) : (printf("%d check(s) failed\n", test_failures), 1))
+
+#endif
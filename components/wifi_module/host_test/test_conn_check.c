@@ -0,0 +1,317 @@
+// conn_check.c against stand-ins on the loopback: a DNS server that answers from a small table
+// (optionally late, or never) and a TCP listener playing the HTTP probe target. The module runs on its
+// own thread through the POSIX shims in posix/, so the probe really goes over UDP and TCP.
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "lwip/dns.h"
+#include "lwip/sockets.h"
+#include "conn_check.h"
+#include "test_common.h"
+
+#define EVENT_WAIT_MS   3000
+#define SLOW_DNS_MS     120
+// Answered after the probe has given up on it
+#define LATE_DNS_MS     600
+#define SHORT_TIMEOUT_MS 300
+
+// ---- Stand-in DNS server ----
+
+static int s_dns_fd;
+static pthread_mutex_t s_dns_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_dns_queries;
+
+static void dns_reply(const uint8_t *query, size_t len, const struct sockaddr_in *from) {
+    // Question name as dotted text, to look it up in the table below
+    char name[128] = "";
+    size_t pos = 12, out = 0;
+    while (pos < len && query[pos] != 0 && out + query[pos] + 1 < sizeof(name)) {
+        if (out > 0) {
+            name[out++] = '.';
+        }
+        memcpy(name + out, query + pos + 1, query[pos]);
+        out += query[pos];
+        pos += query[pos] + 1;
+    }
+    name[out] = '\0';
+    size_t question_end = pos + 1 + 4;
+    if (question_end > len) {
+        return;
+    }
+
+    // A dead resolver: the query is never answered
+    if (strcmp(name, "dead.test") == 0) {
+        return;
+    }
+    bool known = strcmp(name, "portal.test") == 0 || strcmp(name, "slow.test") == 0 ||
+                 strcmp(name, "late.test") == 0;
+    if (strcmp(name, "slow.test") == 0 || strcmp(name, "late.test") == 0) {
+        long ms = strcmp(name, "slow.test") == 0 ? SLOW_DNS_MS : LATE_DNS_MS;
+        struct timespec ts = { 0, ms * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+
+    uint8_t reply[512];
+    memcpy(reply, query, question_end);
+    reply[2] = 0x81;                        // response, recursion desired
+    reply[3] = known ? 0x80 : 0x83;         // recursion available, NOERROR or NXDOMAIN
+    reply[6] = 0;
+    reply[7] = known ? 1 : 0;
+    size_t n = question_end;
+    if (known) {
+        static const uint8_t answer[] = {
+            0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01,  // name pointer, type A, class IN
+            0x00, 0x00, 0x00, 0x3c, 0x00, 0x04,  // TTL 60, 4 bytes
+            127, 0, 0, 1,
+        };
+        memcpy(reply + n, answer, sizeof(answer));
+        n += sizeof(answer);
+    }
+    sendto(s_dns_fd, reply, n, 0, (const struct sockaddr *)from, sizeof(*from));
+}
+
+static void *dns_server(void *arg) {
+    (void)arg;
+    uint8_t buf[512];
+    while (1) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(s_dns_fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 12) {
+            continue;
+        }
+        pthread_mutex_lock(&s_dns_lock);
+        s_dns_queries++;
+        pthread_mutex_unlock(&s_dns_lock);
+        dns_reply(buf, (size_t)n, &from);
+    }
+    return NULL;
+}
+
+static int dns_queries(void) {
+    pthread_mutex_lock(&s_dns_lock);
+    int n = s_dns_queries;
+    pthread_mutex_unlock(&s_dns_lock);
+    return n;
+}
+
+// ---- Stand-in HTTP target ----
+
+static int s_http_fd;
+
+static void *http_server(void *arg) {
+    (void)arg;
+    static const char resp[] = "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n";
+    while (1) {
+        int client = accept(s_http_fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        ssize_t sent = send(client, resp, sizeof(resp) - 1, MSG_NOSIGNAL);
+        (void)sent;
+        close(client);
+    }
+    return NULL;
+}
+
+static uint16_t bind_loopback(int fd) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        perror("bind");
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+// A loopback port nothing listens on: bound, then closed again
+static uint16_t closed_port(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    uint16_t port = bind_loopback(fd);
+    close(fd);
+    return port;
+}
+
+// ---- Event loop stand-in ----
+
+static pthread_mutex_t s_event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_event_cond = PTHREAD_COND_INITIALIZER;
+static int s_event_count;
+static int32_t s_event_id;
+static conn_check_result_t s_event_result;
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size, TickType_t ticks) {
+    (void)ticks;
+    if (base != CONN_CHECK_EVENT || size != sizeof(conn_check_result_t)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_event_lock);
+    s_event_id = id;
+    memcpy(&s_event_result, data, size);
+    s_event_count++;
+    pthread_cond_signal(&s_event_cond);
+    pthread_mutex_unlock(&s_event_lock);
+    return ESP_OK;
+}
+
+// Trigger a check and wait for the event it publishes; false if none came
+static bool check(bool force, int32_t *id, conn_check_result_t *result) {
+    pthread_mutex_lock(&s_event_lock);
+    int seen = s_event_count;
+    pthread_mutex_unlock(&s_event_lock);
+
+    conn_check_trigger(force);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += EVENT_WAIT_MS / 1000;
+    pthread_mutex_lock(&s_event_lock);
+    while (s_event_count == seen) {
+        if (pthread_cond_timedwait(&s_event_cond, &s_event_lock, &deadline) != 0) {
+            break;
+        }
+    }
+    bool got = s_event_count != seen;
+    *id = s_event_id;
+    *result = s_event_result;
+    pthread_mutex_unlock(&s_event_lock);
+    return got;
+}
+
+static uint32_t hist_total(const uint32_t *hist) {
+    uint32_t total = 0;
+    for (int i = 0; i < CONN_CHECK_HIST_BUCKETS; i++) {
+        total += hist[i];
+    }
+    return total;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+int main(void) {
+    pthread_t thread;
+
+    s_dns_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    host_dns_server_port = bind_loopback(s_dns_fd);
+    s_http_fd = socket(AF_INET, SOCK_STREAM, 0);
+    uint16_t http_port = bind_loopback(s_http_fd);
+    if (host_dns_server_port == 0 || http_port == 0 || listen(s_http_fd, 8) != 0) {
+        fprintf(stderr, "can't set up the loopback stand-ins\n");
+        return 1;
+    }
+    pthread_create(&thread, NULL, dns_server, NULL);
+    pthread_detach(thread);
+    pthread_create(&thread, NULL, http_server, NULL);
+    pthread_detach(thread);
+
+    int32_t id;
+    conn_check_result_t result;
+    conn_check_result_t cached;
+    conn_check_config_t config = {
+        .host = "portal.test", .port = http_port, .timeout_ms = 1000, .ttl_ms = 60000,
+    };
+
+    // Nothing cached before the first probe
+    CHECK(!conn_check_get_result(&cached));
+    CHECK(conn_check_init(&config) == ESP_OK);
+
+    // Reachable target: one lookup, one connect, ONLINE
+    CHECK(check(false, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_ONLINE);
+    CHECK(result.online && result.dns_ok);
+    CHECK(result.timestamp_us != 0);
+    CHECK(dns_queries() == 1);
+    CHECK(conn_check_get_result(&cached) && cached.online);
+
+    // Within the TTL the cached result is re-published without probing again...
+    CHECK(check(false, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_ONLINE);
+    CHECK(dns_queries() == 1);
+
+    // ...unless forced
+    CHECK(check(true, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_ONLINE);
+    CHECK(dns_queries() == 2);
+
+    // Invalidation drops the cache, so the next trigger probes
+    conn_check_invalidate();
+    CHECK(!conn_check_get_result(&cached));
+    CHECK(check(false, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_ONLINE);
+    CHECK(dns_queries() == 3);
+
+    // A result older than the TTL is probed again
+    config.ttl_ms = 100;
+    CHECK(conn_check_init(&config) == ESP_OK);
+    sleep_ms(150);
+    CHECK(!conn_check_get_result(&cached));
+    CHECK(check(false, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_ONLINE);
+    CHECK(dns_queries() == 4);
+    config.ttl_ms = 60000;
+
+    // Name that doesn't resolve: OFFLINE with dns_ok clear
+    config.host = "missing.test";
+    CHECK(conn_check_init(&config) == ESP_OK);
+    CHECK(check(true, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_OFFLINE);
+    CHECK(!result.online && !result.dns_ok);
+    CHECK(dns_queries() == 5);
+
+    // Resolves but the port refuses: OFFLINE with dns_ok set
+    config.host = "portal.test";
+    config.port = closed_port();
+    CHECK(conn_check_init(&config) == ESP_OK);
+    CHECK(check(true, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_OFFLINE);
+    CHECK(!result.online && result.dns_ok);
+
+    // A slow resolver shows up in dns_ms and lands in the 250 ms bucket
+    config.host = "slow.test";
+    config.port = http_port;
+    CHECK(conn_check_init(&config) == ESP_OK);
+    conn_check_histograms_t before, after;
+    conn_check_get_histograms(&before);
+    CHECK(check(true, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_ONLINE);
+    CHECK(result.dns_ms >= SLOW_DNS_MS);
+    conn_check_get_histograms(&after);
+    CHECK(after.dns[4] == before.dns[4] + 1);
+
+    CHECK(after.dns_sum_ms >= before.dns_sum_ms + SLOW_DNS_MS);
+
+    // A resolver that never answers is bounded by timeout_ms, not by lwIP's own retries
+    config.host = "dead.test";
+    config.timeout_ms = SHORT_TIMEOUT_MS;
+    CHECK(conn_check_init(&config) == ESP_OK);
+    CHECK(check(true, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_OFFLINE);
+    CHECK(!result.online && !result.dns_ok);
+    CHECK(result.dns_ms >= SHORT_TIMEOUT_MS - 10 && result.dns_ms < SHORT_TIMEOUT_MS + 200);
+
+    // An answer that comes after the probe gave up must not be taken for the next lookup's:
+    // late.test is answered while the following dead.test lookup waits, which has to time out
+    config.host = "late.test";
+    CHECK(conn_check_init(&config) == ESP_OK);
+    CHECK(check(true, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_OFFLINE);
+    CHECK(!result.dns_ok && result.dns_ms < SHORT_TIMEOUT_MS + 200);
+    config.host = "dead.test";
+    config.timeout_ms = 1000;
+    CHECK(conn_check_init(&config) == ESP_OK);
+    CHECK(check(true, &id, &result));
+    CHECK(id == CONN_CHECK_EVENT_OFFLINE);
+    CHECK(!result.dns_ok && result.dns_ms >= 1000 - 10);
+
+    // Every probe adds one DNS sample; only those that resolved add a TCP sample
+    conn_check_get_histograms(&after);
+    CHECK(hist_total(after.dns) == 10);
+    CHECK(hist_total(after.tcp) == 6);
+
+    return TEST_EXIT();
+}
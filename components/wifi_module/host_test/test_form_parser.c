@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "form_parser.h"
+
+/*
+ * Property tests for the in-place form tokenizer. A deliberately naive reference decoder (split on
+ * '&', then on the first '=', decode each part into its own buffer) must agree with it on every input.
+ */
+
+#define MAX_PAIRS 64
+#define MAX_INPUT 512
+
+typedef struct {
+    char key[MAX_INPUT];
+    size_t key_len;
+    char value[MAX_INPUT];
+    size_t value_len;
+} pair_t;
+
+static int ref_hex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static size_t ref_decode(const char *src, size_t len, char *dst) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] == '+') {
+            dst[n++] = ' ';
+        } else if (src[i] == '%' && i + 2 < len && ref_hex(src[i + 1]) >= 0 && ref_hex(src[i + 2]) >= 0) {
+            dst[n++] = (char)(ref_hex(src[i + 1]) * 16 + ref_hex(src[i + 2]));
+            i += 2;
+        } else {
+            dst[n++] = src[i];
+        }
+    }
+    return n;
+}
+
+static int ref_parse(const char *in, size_t len, pair_t *pairs) {
+    int count = 0;
+    size_t start = 0;
+    while (start <= len) {
+        size_t end = start;
+        while (end < len && in[end] != '&') {
+            end++;
+        }
+        if (end > start) {
+            size_t eq = start;
+            while (eq < end && in[eq] != '=') {
+                eq++;
+            }
+            pair_t *p = &pairs[count++];
+            p->key_len = ref_decode(&in[start], eq - start, p->key);
+            p->value_len = eq < end ? ref_decode(&in[eq + 1], end - eq - 1, p->value) : 0;
+        }
+        start = end + 1;
+    }
+    return count;
+}
+
+// Parses an exact-size heap copy (plus the terminator byte callers reserve) and compares with the reference
+static void check_against_reference(const char *in, size_t len) {
+    pair_t expected[MAX_PAIRS];
+    int expected_count = ref_parse(in, len, expected);
+
+    char *buf = malloc(len + 1);
+    memcpy(buf, in, len);
+    // A hex digit in the spare byte turns a read past the input into a wrong decode
+    buf[len] = '7';
+    form_parser_t parser;
+    form_parser_init(&parser, buf, len);
+
+    char *key, *value;
+    size_t key_len, value_len;
+    int count = 0;
+    while (form_parser_next(&parser, &key, &key_len, &value, &value_len)) {
+        CHECK(count < expected_count);
+        if (count >= expected_count) {
+            break;
+        }
+        const pair_t *p = &expected[count++];
+        CHECK(key_len == p->key_len && memcmp(key, p->key, key_len) == 0);
+        CHECK(value_len == p->value_len && memcmp(value, p->value, value_len) == 0);
+        // Both are terminated in place, and stay inside the caller's buffer
+        CHECK(key[key_len] == '\0' && value[value_len] == '\0');
+        CHECK(key >= buf && value + value_len <= buf + len);
+    }
+    CHECK(count == expected_count);
+    if (count != expected_count) {
+        fprintf(stderr, "input: %.*s\n", (int)len, in);
+    }
+    free(buf);
+}
+
+// Hand-picked edge cases, also the seeds for the mutation run below
+static const char *corpus[] = {
+    "", "&", "&&&", "=", "==", "a", "a=", "=b", "a=b", "a=b&", "&a=b", "a=b&&c=d", "a=b=c",
+    "ssid=Home&pass=secret123", "ssid=My+Home+WiFi&pass=p%40ss%20w0rd%21",
+    "ssid=%E2%9C%93&pass=%00%00", "a=%", "a=%4", "a=%4g", "a=%%41", "a=%41%", "%3D=%26",
+    "ssid=x%26pass%3Dy", "k%3dv=1", "+=+", "a=1&a=2", "pass=&ssid=", "%zz=%ZZ", "a=b%2",
+};
+
+static void test_corpus(void) {
+    for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+        check_against_reference(corpus[i], strlen(corpus[i]));
+    }
+}
+
+static void test_known_answers(void) {
+    char buf[] = "ssid=My+Home%21&&pass=a%3Db%26c&flag";
+    form_parser_t parser;
+    char *key, *value;
+    size_t key_len, value_len;
+
+    form_parser_init(&parser, buf, strlen(buf));
+    CHECK(form_parser_next(&parser, &key, &key_len, &value, &value_len));
+    CHECK(strcmp(key, "ssid") == 0 && strcmp(value, "My Home!") == 0 && value_len == 8);
+    CHECK(form_parser_next(&parser, &key, &key_len, &value, &value_len));
+    CHECK(strcmp(key, "pass") == 0 && strcmp(value, "a=b&c") == 0);
+    CHECK(form_parser_next(&parser, &key, &key_len, &value, &value_len));
+    CHECK(strcmp(key, "flag") == 0 && value_len == 0 && value[0] == '\0');
+    CHECK(!form_parser_next(&parser, &key, &key_len, &value, &value_len));
+
+    // Lowercase hex, the case the old url_decode got wrong
+    char lower[] = "p=%c3%a9";
+    form_parser_init(&parser, lower, strlen(lower));
+    CHECK(form_parser_next(&parser, &key, &key_len, &value, &value_len));
+    CHECK(value_len == 2 && (unsigned char)value[0] == 0xc3 && (unsigned char)value[1] == 0xa9);
+
+    // %00 survives, so lengths rather than strlen() tell where a value ends
+    char nul[] = "p=a%00b";
+    form_parser_init(&parser, nul, strlen(nul));
+    CHECK(form_parser_next(&parser, &key, &key_len, &value, &value_len));
+    CHECK(value_len == 3 && value[1] == '\0' && strlen(value) == 1);
+}
+
+static void random_fill(char *buf, size_t len) {
+    static const char alphabet[] = "ab=&%+0aF9gZ";
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand() % 4 == 0 ? (char)(rand() % 256) : alphabet[rand() % (int)(sizeof(alphabet) - 1)];
+    }
+}
+
+// Random and mutated inputs: the parser and the reference must agree, and ASan watches the buffer edges
+static void test_random_inputs(void) {
+    char in[MAX_INPUT / 2];
+
+    srand(424242);
+    for (int iter = 0; iter < 100000; iter++) {
+        size_t len;
+        if (iter % 2 == 0) {
+            len = (size_t)(rand() % (int)sizeof(in));
+            random_fill(in, len);
+        } else {
+            const char *seed = corpus[rand() % (int)(sizeof(corpus) / sizeof(corpus[0]))];
+            len = strlen(seed);
+            memcpy(in, seed, len);
+            for (int m = rand() % 4; m >= 0 && len > 0; m--) {
+                in[rand() % (int)len] = "=&%+A"[rand() % 5];
+            }
+            if (len + 3 < sizeof(in) && rand() % 2) {
+                memcpy(&in[len], "%4", 2);
+                len += 2;
+            }
+        }
+        check_against_reference(in, len);
+    }
+}
+
+static char *percent_encode(const char *src, size_t len, char *dst) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)src[i];
+        if (c == ' ') {
+            *dst++ = '+';
+        } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' ||
+                   c == '_' || c == '.' || c == '~') {
+            *dst++ = (char)c;
+        } else {
+            *dst++ = '%';
+            *dst++ = hex[c >> 4];
+            *dst++ = hex[c & 0x0f];
+        }
+    }
+    return dst;
+}
+
+// Whatever a browser encodes (any bytes, including NUL, '&' and '=') comes back unchanged
+static void test_encode_round_trip(void) {
+    srand(777);
+    for (int iter = 0; iter < 20000; iter++) {
+        char ssid[32], pass[64];
+        size_t ssid_len = 1 + (size_t)(rand() % 32), pass_len = (size_t)(rand() % 65);
+        for (size_t i = 0; i < ssid_len; i++) {
+            ssid[i] = (char)(rand() % 256);
+        }
+        for (size_t i = 0; i < pass_len; i++) {
+            pass[i] = (char)(rand() % 256);
+        }
+
+        char form[3 * (32 + 64) + 16];
+        char *w = form;
+        w = percent_encode("ssid", 4, w);
+        *w++ = '=';
+        w = percent_encode(ssid, ssid_len, w);
+        *w++ = '&';
+        w = percent_encode("pass", 4, w);
+        *w++ = '=';
+        w = percent_encode(pass, pass_len, w);
+        size_t len = (size_t)(w - form);
+
+        char *buf = malloc(len + 1);
+        memcpy(buf, form, len);
+        form_parser_t parser;
+        char *key, *value;
+        size_t key_len, value_len;
+        form_parser_init(&parser, buf, len);
+        CHECK(form_parser_next(&parser, &key, &key_len, &value, &value_len));
+        CHECK(strcmp(key, "ssid") == 0 && value_len == ssid_len && memcmp(value, ssid, ssid_len) == 0);
+        CHECK(form_parser_next(&parser, &key, &key_len, &value, &value_len));
+        CHECK(strcmp(key, "pass") == 0 && value_len == pass_len && memcmp(value, pass, pass_len) == 0);
+        CHECK(!form_parser_next(&parser, &key, &key_len, &value, &value_len));
+        free(buf);
+    }
+}
+
+int main(void) {
+    test_known_answers();
+    test_corpus();
+    test_random_inputs();
+    test_encode_round_trip();
+    return TEST_EXIT();
+}
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "prov_tlv.h"
+
+// Decodes from an exact-size heap copy, so ASan catches any read past the payload
+static prov_tlv_err_t decode_exact(const uint8_t *buf, size_t len, prov_tlv_creds_t *creds) {
+    uint8_t *copy = malloc(len > 0 ? len : 1);
+    memcpy(copy, buf, len);
+    prov_tlv_err_t err = prov_tlv_decode(copy, len, creds);
+    free(copy);
+    return err;
+}
+
+static bool creds_equal(const prov_tlv_creds_t *a, const prov_tlv_creds_t *b) {
+    return strcmp(a->ssid, b->ssid) == 0 && strcmp(a->passphrase, b->passphrase) == 0 &&
+           a->has_psk == b->has_psk && (!a->has_psk || memcmp(a->psk, b->psk, sizeof(a->psk)) == 0) &&
+           a->has_bssid == b->has_bssid && (!a->has_bssid || memcmp(a->bssid, b->bssid, sizeof(a->bssid)) == 0);
+}
+
+static void check_round_trip(const prov_tlv_creds_t *in) {
+    uint8_t buf[PROV_TLV_MAX_LEN];
+    size_t len = 0;
+    prov_tlv_creds_t out;
+
+    CHECK(prov_tlv_encode(in, buf, sizeof(buf), &len) == PROV_TLV_OK);
+    CHECK(decode_exact(buf, len, &out) == PROV_TLV_OK);
+    CHECK(creds_equal(in, &out));
+
+    // Every smaller buffer is refused rather than overrun
+    for (size_t cap = 0; cap < len; cap++) {
+        uint8_t *small = malloc(cap > 0 ? cap : 1);
+        size_t small_len = 0;
+        CHECK(prov_tlv_encode(in, small, cap, &small_len) == PROV_TLV_ERR_NO_SPACE);
+        free(small);
+    }
+    // Every strict prefix is refused: truncated inside a field, or missing the fields after it
+    for (size_t cut = 0; cut < len; cut++) {
+        prov_tlv_err_t err = decode_exact(buf, cut, &out);
+        CHECK(err != PROV_TLV_OK || !creds_equal(in, &out));
+    }
+}
+
+static void test_round_trips(void) {
+    prov_tlv_creds_t c;
+
+    memset(&c, 0, sizeof(c));
+    strcpy(c.ssid, "HomeNet");
+    strcpy(c.passphrase, "correct horse");
+    check_round_trip(&c);
+
+    // Open network: SSID only
+    memset(&c, 0, sizeof(c));
+    strcpy(c.ssid, "CafeGuest");
+    check_round_trip(&c);
+
+    memset(&c, 0, sizeof(c));
+    strcpy(c.ssid, "PskOnly");
+    for (int i = 0; i < 32; i++) {
+        c.psk[i] = (uint8_t)(i * 7 + 1);
+    }
+    c.has_psk = true;
+    memcpy(c.bssid, "\x02\x11\x22\x33\x44\x55", 6);
+    c.has_bssid = true;
+    check_round_trip(&c);
+
+    // Every field at its maximum fills PROV_TLV_MAX_LEN exactly
+    uint8_t buf[PROV_TLV_MAX_LEN];
+    size_t len = 0;
+    memset(&c, 0, sizeof(c));
+    memset(c.ssid, 'S', 32);
+    memset(c.passphrase, 'p', 64);
+    c.has_bssid = true;
+    check_round_trip(&c);
+    CHECK(prov_tlv_encode(&c, buf, sizeof(buf), &len) == PROV_TLV_OK);
+    CHECK(len == PROV_TLV_MAX_LEN);
+}
+
+static void test_wire_format(void) {
+    static const uint8_t expected[] = {
+        0x01,
+        0x01, 2, 'a', 'b',
+        0x02, 8, '1', '2', '3', '4', '5', '6', '7', '8',
+    };
+    prov_tlv_creds_t c;
+    uint8_t buf[PROV_TLV_MAX_LEN];
+    size_t len = 0;
+
+    memset(&c, 0, sizeof(c));
+    strcpy(c.ssid, "ab");
+    strcpy(c.passphrase, "12345678");
+    CHECK(prov_tlv_encode(&c, buf, sizeof(buf), &len) == PROV_TLV_OK);
+    CHECK(len == sizeof(expected) && memcmp(buf, expected, len) == 0);
+
+    // Field order is not significant on the way in
+    static const uint8_t reordered[] = {
+        0x01,
+        0x02, 8, '1', '2', '3', '4', '5', '6', '7', '8',
+        0x01, 2, 'a', 'b',
+    };
+    prov_tlv_creds_t out;
+    CHECK(decode_exact(reordered, sizeof(reordered), &out) == PROV_TLV_OK);
+    CHECK(creds_equal(&c, &out));
+}
+
+static void test_forward_compatible(void) {
+    // Unknown types from a newer client are skipped, even past PROV_TLV_MAX_LEN (the BLE write
+    // accepts up to a full attribute for this reason)
+    uint8_t buf[512];
+    size_t pos = 0;
+    buf[pos++] = 0x01;
+    buf[pos++] = 0x09;
+    buf[pos++] = 200;
+    memset(&buf[pos], 0xee, 200);
+    pos += 200;
+    buf[pos++] = 0x01;
+    buf[pos++] = 4;
+    memcpy(&buf[pos], "Mesh", 4);
+    pos += 4;
+    buf[pos++] = 0xff;
+    buf[pos++] = 0;
+    CHECK(pos > PROV_TLV_MAX_LEN);
+
+    prov_tlv_creds_t out;
+    CHECK(decode_exact(buf, pos, &out) == PROV_TLV_OK);
+    CHECK(strcmp(out.ssid, "Mesh") == 0);
+    CHECK(!out.has_psk && !out.has_bssid && out.passphrase[0] == '\0');
+
+    // Repeats of an unknown type are fine too; the rule against duplicates is for known ones
+    static const uint8_t repeated[] = { 0x01, 0x20, 1, 'x', 0x20, 1, 'y', 0x01, 1, 'n' };
+    CHECK(decode_exact(repeated, sizeof(repeated), &out) == PROV_TLV_OK);
+}
+
+static void test_rejects(void) {
+    static const struct {
+        const char *what;
+        uint8_t bytes[48];
+        size_t len;
+        prov_tlv_err_t err;
+    } cases[] = {
+        { "empty", { 0 }, 0, PROV_TLV_ERR_VERSION },
+        { "version 2", { 0x02, 0x01, 1, 'a' }, 4, PROV_TLV_ERR_VERSION },
+        { "version only", { 0x01 }, 1, PROV_TLV_ERR_MISSING },
+        { "half a header", { 0x01, 0x01 }, 2, PROV_TLV_ERR_TRUNCATED },
+        { "value cut short", { 0x01, 0x01, 4, 'a', 'b' }, 5, PROV_TLV_ERR_TRUNCATED },
+        { "empty ssid", { 0x01, 0x01, 0 }, 3, PROV_TLV_ERR_FIELD },
+        { "NUL in ssid", { 0x01, 0x01, 3, 'a', 0, 'b' }, 6, PROV_TLV_ERR_FIELD },
+        { "duplicate ssid", { 0x01, 0x01, 1, 'a', 0x01, 1, 'b' }, 7, PROV_TLV_ERR_FIELD },
+        { "short passphrase", { 0x01, 0x01, 1, 'a', 0x02, 7, '1', '2', '3', '4', '5', '6', '7' }, 13,
+          PROV_TLV_ERR_FIELD },
+        { "short psk", { 0x01, 0x01, 1, 'a', 0x03, 2, 1, 2 }, 8, PROV_TLV_ERR_FIELD },
+        { "short bssid", { 0x01, 0x01, 1, 'a', 0x04, 5, 1, 2, 3, 4, 5 }, 11, PROV_TLV_ERR_FIELD },
+        { "no ssid", { 0x01, 0x04, 6, 1, 2, 3, 4, 5, 6 }, 9, PROV_TLV_ERR_MISSING },
+    };
+    prov_tlv_creds_t out;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        prov_tlv_err_t err = decode_exact(cases[i].bytes, cases[i].len, &out);
+        if (err != cases[i].err) {
+            fprintf(stderr, "%s: got %d, want %d\n", cases[i].what, err, cases[i].err);
+        }
+        CHECK(err == cases[i].err);
+    }
+
+    // Passphrase and PSK together
+    uint8_t both[1 + 3 + 10 + 34] = { 0x01, 0x01, 1, 'a', 0x02, 8, '1', '2', '3', '4', '5', '6', '7', '8', 0x03, 32 };
+    CHECK(decode_exact(both, sizeof(both), &out) == PROV_TLV_ERR_FIELD);
+
+    // Over-long SSID and passphrase
+    uint8_t long_ssid[3 + 33] = { 0x01, 0x01, 33 };
+    memset(&long_ssid[3], 'a', 33);
+    CHECK(decode_exact(long_ssid, sizeof(long_ssid), &out) == PROV_TLV_ERR_FIELD);
+    uint8_t long_pass[4 + 2 + 65] = { 0x01, 0x01, 1, 'a', 0x02, 65 };
+    memset(&long_pass[6], 'p', 65);
+    CHECK(decode_exact(long_pass, sizeof(long_pass), &out) == PROV_TLV_ERR_FIELD);
+}
+
+static void test_encode_rejects(void) {
+    prov_tlv_creds_t c;
+    uint8_t buf[PROV_TLV_MAX_LEN];
+    size_t len = 0;
+
+    memset(&c, 0, sizeof(c));
+    CHECK(prov_tlv_encode(&c, buf, sizeof(buf), &len) == PROV_TLV_ERR_MISSING);
+
+    strcpy(c.ssid, "net");
+    strcpy(c.passphrase, "short");
+    CHECK(prov_tlv_encode(&c, buf, sizeof(buf), &len) == PROV_TLV_ERR_FIELD);
+
+    strcpy(c.passphrase, "long enough");
+    c.has_psk = true;
+    CHECK(prov_tlv_encode(&c, buf, sizeof(buf), &len) == PROV_TLV_ERR_FIELD);
+}
+
+// Random payloads: decoding never reads out of bounds, and whatever decodes re-encodes to the same credentials
+static void test_random_payloads(void) {
+    uint8_t buf[160];
+    unsigned accepted = 0;
+
+    srand(12345);
+    for (int iter = 0; iter < 200000; iter++) {
+        size_t len = (size_t)(rand() % (int)sizeof(buf));
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = (uint8_t)rand();
+        }
+        if (len > 0 && rand() % 4 != 0) {
+            buf[0] = PROV_TLV_VERSION;
+        }
+        // Bias towards plausible fields so the decoder gets past the header now and then
+        for (size_t pos = 1; pos + 2 < len && rand() % 3 != 0; ) {
+            buf[pos] = (uint8_t)(rand() % 10);
+            buf[pos + 1] = (uint8_t)(rand() % 40);
+            pos += 2 + buf[pos + 1];
+        }
+
+        prov_tlv_creds_t out, again;
+        if (decode_exact(buf, len, &out) != PROV_TLV_OK) {
+            continue;
+        }
+        accepted++;
+        uint8_t enc[PROV_TLV_MAX_LEN];
+        size_t enc_len = 0;
+        CHECK(prov_tlv_encode(&out, enc, sizeof(enc), &enc_len) == PROV_TLV_OK);
+        CHECK(decode_exact(enc, enc_len, &again) == PROV_TLV_OK);
+        CHECK(creds_equal(&out, &again));
+    }
+    printf("random payloads: %u of 200000 decoded\n", accepted);
+    CHECK(accepted > 0);
+}
+
+int main(void) {
+    test_round_trips();
+    test_wire_format();
+    test_forward_compatible();
+    test_rejects();
+    test_encode_rejects();
+    test_random_payloads();
+    return TEST_EXIT();
+}
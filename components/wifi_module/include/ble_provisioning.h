@@ -1,8 +1,66 @@
 #ifndef BLE_PROVISIONING_H
 #define BLE_PROVISIONING_H
 
+#include <stdint.h>
+
 #define GATT_WIFI_SSID_UUID 0xFF01
 #define GATT_WIFI_PASS_UUID 0xFF02
+#define GATT_WIFI_CRED_UUID 0xFF03  // combined TLV payload (prov_tlv.h)
+#define GATT_WIFI_STATUS_UUID 0xFF04  // read/notify/indicate, see ble_prov_status_t
+
+// Preferred ATT MTU; 185 is what iOS offers and fits PROV_TLV_MAX_LEN plus the write header
+#define BLE_PROV_PREFERRED_MTU 185
+
+/*
+ * Advertising profile: a short fast burst for quick discovery, then a slow duty cycle for the rest
+ * of the provisioning window. Every disconnect starts a new fast burst.
+ * Defaults follow the usual phone-friendly values (20 ms for 30 s, then ~1 s).
+ */
+#ifndef BLE_ADV_FAST_ITVL_MIN_MS
+#define BLE_ADV_FAST_ITVL_MIN_MS   20
+#endif
+#ifndef BLE_ADV_FAST_ITVL_MAX_MS
+#define BLE_ADV_FAST_ITVL_MAX_MS   30
+#endif
+#ifndef BLE_ADV_FAST_DURATION_MS
+#define BLE_ADV_FAST_DURATION_MS   30000
+#endif
+#ifndef BLE_ADV_SLOW_ITVL_MIN_MS
+#define BLE_ADV_SLOW_ITVL_MIN_MS   1000
+#endif
+#ifndef BLE_ADV_SLOW_ITVL_MAX_MS
+#define BLE_ADV_SLOW_ITVL_MAX_MS   1285
+#endif
+
+// Status transitions waiting for the host task; older ones are dropped if it falls behind
+#define BLE_PROV_STATUS_QUEUE_LEN 8
+
+/**
+ * @brief Provisioning progress pushed on GATT_WIFI_STATUS_UUID as {state, reason, ip[4]}.
+ *        reason is the Wi-Fi disconnect reason for BLE_PROV_STATUS_FAILED (0 = timed out),
+ *        ip is in network byte order and set for BLE_PROV_STATUS_CONNECTED.
+ */
+typedef enum {
+    BLE_PROV_STATUS_IDLE = 0,
+    BLE_PROV_STATUS_RECEIVED,
+    BLE_PROV_STATUS_SAVING,
+    BLE_PROV_STATUS_CONNECTING,
+    BLE_PROV_STATUS_CONNECTED,
+    BLE_PROV_STATUS_FAILED,
+} ble_prov_status_t;
+
+/**
+ * @brief Publish a status transition to subscribed BLE clients. Never blocks: the value is queued
+ *        and sent from the NimBLE host task. Safe to call from any task, and when BLE is not running.
+ */
+void ble_provisioning_notify_status(ble_prov_status_t status, uint8_t reason, uint32_t ip);
+
+/**
+ * @brief Release the BT controller's memory to the heap. Permanent until reboot; afterwards
+ *        start_ble_provisioning() only logs a warning. Must be called while BLE is not running,
+ *        and only on paths that can never open the provisioning portal again in this boot.
+ */
+void ble_provisioning_release_memory(void);
 
 void start_ble_provisioning(void);
 void stop_ble_provisioning(void);
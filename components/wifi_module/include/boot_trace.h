@@ -0,0 +1,69 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed-size ring of stage stamps; the oldest entries are overwritten once it wraps
+#define BOOT_TRACE_RING_SIZE  64
+
+/**
+ * @brief Stages between app_main and a working connection (and of the provisioning flow).
+ *        Keep boot_trace_stage_name() in sync when adding one.
+ */
+typedef enum {
+    TRACE_INIT_START,
+    TRACE_NVS_READY,
+    TRACE_NETIF_READY,
+    TRACE_EVENT_LOOP_READY,
+    TRACE_WIFI_INIT_DONE,
+    TRACE_WIFI_STARTED,
+    TRACE_SCAN_START,
+    TRACE_SCAN_DONE,
+    TRACE_STA_CONNECTED,
+    TRACE_GOT_IP,
+    TRACE_PROBE_DONE,
+    TRACE_SOFTAP_STARTED,
+    TRACE_HTTPD_STARTED,
+    TRACE_BLE_STARTED,
+    TRACE_BLE_CONNECTED,
+    TRACE_CREDS_RECEIVED,
+    TRACE_PORTAL_CLOSED,
+    TRACE_STAGE_COUNT,
+} boot_trace_stage_t;
+
+typedef struct {
+    int64_t t_us;           // esp_timer time
+    uint32_t arg;           // stage specific (disconnect reason, latency, ...)
+    uint8_t stage;
+} boot_trace_entry_t;
+
+/**
+ * @brief Stamp a stage. Lock-free and allocation-free; safe from any task.
+ */
+void boot_trace_mark(boot_trace_stage_t stage, uint32_t arg);
+
+/**
+ * @brief Iterate the ring from oldest to newest. Start with *cursor = 0.
+ * @return false past the newest entry. Entries being overwritten concurrently are skipped.
+ */
+bool boot_trace_read(uint32_t *cursor, boot_trace_entry_t *entry);
+
+/**
+ * @brief When a stage was first reached (0 = never) and how often it has been reached since boot.
+ */
+void boot_trace_get_stage(boot_trace_stage_t stage, int64_t *first_us, uint32_t *count);
+
+/**
+ * @brief Entries stamped since boot, including those already overwritten.
+ */
+uint32_t boot_trace_total(void);
+
+const char *boot_trace_stage_name(boot_trace_stage_t stage);
+
+/**
+ * @brief Print the ring as "stage,t_us,arg" lines for tools/trace_percentiles.py.
+ */
+void boot_trace_dump_log(void);
+
+#endif
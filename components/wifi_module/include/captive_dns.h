@@ -0,0 +1,37 @@
+#ifndef CAPTIVE_DNS_H
+#define CAPTIVE_DNS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+#define CAPTIVE_DNS_PORT          53
+// Queries longer than this are dropped; a single-question query is far shorter
+#define CAPTIVE_DNS_BUF_LEN       512
+// Short, so clients re-resolve soon after the portal closes
+#define CAPTIVE_DNS_TTL_S         10
+// recvfrom() timeout; bounds how long captive_dns_stop() waits for the task to exit
+#define CAPTIVE_DNS_POLL_MS       250
+
+typedef struct {
+    uint32_t answered;          // A queries answered with the portal address
+    uint32_t empty;             // other query types, answered with no records
+    uint32_t dropped;           // malformed, oversized or not a query
+} captive_dns_stats_t;
+
+/**
+ * @brief Answer every A query on the SoftAP with ip, so phones land on the portal.
+ *        Packets are parsed and answered in one static buffer; nothing is allocated per query.
+ * @param ip IPv4 address in network byte order (esp_netif_ip_info_t.ip.addr).
+ */
+esp_err_t captive_dns_start(uint32_t ip);
+
+/**
+ * @brief Stop the responder and wait (up to a few CAPTIVE_DNS_POLL_MS) for it to close its socket.
+ *        With PROV_STATIC_ALLOC the task stays parked for the next captive_dns_start().
+ */
+void captive_dns_stop(void);
+
+void captive_dns_get_stats(captive_dns_stats_t *stats);
+
+#endif
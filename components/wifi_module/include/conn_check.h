@@ -0,0 +1,87 @@
+#ifndef CONN_CHECK_H
+#define CONN_CHECK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "sdkconfig.h"
+#include "task_plan.h"
+
+// Probe target used by conn_check_init(NULL); set in menuconfig under "WiFi module"
+#ifdef CONFIG_WIFI_MODULE_CONN_CHECK_HOST
+#define CONN_CHECK_DEFAULT_HOST       CONFIG_WIFI_MODULE_CONN_CHECK_HOST
+#define CONN_CHECK_DEFAULT_PORT       CONFIG_WIFI_MODULE_CONN_CHECK_PORT
+#define CONN_CHECK_DEFAULT_TIMEOUT_MS CONFIG_WIFI_MODULE_CONN_CHECK_TIMEOUT_MS
+#define CONN_CHECK_DEFAULT_TTL_MS     CONFIG_WIFI_MODULE_CONN_CHECK_TTL_MS
+#else
+#define CONN_CHECK_DEFAULT_HOST       "google.com"
+#define CONN_CHECK_DEFAULT_PORT       80
+#define CONN_CHECK_DEFAULT_TIMEOUT_MS 5000
+#define CONN_CHECK_DEFAULT_TTL_MS     60000
+#endif
+
+// Latency histogram bucket upper bounds in ms; the last bucket catches everything slower
+#define CONN_CHECK_HIST_BUCKETS       8
+#define CONN_CHECK_HIST_BOUNDS_MS     { 10, 25, 50, 100, 250, 500, 1000, UINT32_MAX }
+
+ESP_EVENT_DECLARE_BASE(CONN_CHECK_EVENT);
+
+typedef enum {
+    CONN_CHECK_EVENT_ONLINE,        // probe target resolved and accepted a TCP connection
+    CONN_CHECK_EVENT_OFFLINE,       // DNS or TCP connect failed / timed out
+} conn_check_event_t;
+
+typedef struct {
+    const char *host;               // must outlive the module
+    uint16_t port;
+    uint32_t timeout_ms;            // bound on the DNS lookup, and separately on the TCP connect
+    uint32_t ttl_ms;                // how long a result is reused before probing again
+} conn_check_config_t;
+
+/**
+ * @brief Result of one probe; also the payload of CONN_CHECK_EVENT.
+ */
+typedef struct {
+    bool online;
+    bool dns_ok;
+    uint32_t dns_ms;
+    uint32_t tcp_ms;
+    int64_t timestamp_us;           // esp_timer time of the probe, 0 if none yet
+} conn_check_result_t;
+
+typedef struct {
+    uint32_t dns[CONN_CHECK_HIST_BUCKETS];
+    uint32_t tcp[CONN_CHECK_HIST_BUCKETS];
+    uint32_t dns_sum_ms;
+    uint32_t tcp_sum_ms;
+} conn_check_histograms_t;
+
+/**
+ * @brief Start the probe task. Pass NULL for the defaults above.
+ */
+esp_err_t conn_check_init(const conn_check_config_t *config);
+
+/**
+ * @brief Ask for a probe without waiting for it. A cached result younger than the TTL is
+ *        re-published instead, unless force is set.
+ */
+void conn_check_trigger(bool force);
+
+/**
+ * @brief Drop the cached result (e.g. on disconnect).
+ */
+void conn_check_invalidate(void);
+
+/**
+ * @brief Last cached result.
+ * @return true if it is still within the TTL.
+ */
+bool conn_check_get_result(conn_check_result_t *result);
+
+/**
+ * @brief Snapshot of the DNS and TCP-connect latency histograms.
+ */
+void conn_check_get_histograms(conn_check_histograms_t *hist);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "task_plan.h"
+
+/*
+ * Deferred logging for event handlers, GATT callbacks and httpd handlers.
+ * A call site stores a message ID plus raw arguments in its core's ring and returns;
+ * a low-priority task formats and prints them later, so callbacks never wait on the UART.
+ * Messages are declared in dlog.c; formats take the optional string first, then up to
+ * four 32-bit arguments.
+ */
+
+// 0 formats on the spot (the old behaviour), for comparing callback latency
+#ifndef DLOG_DEFERRED
+#define DLOG_DEFERRED       1
+#endif
+#define DLOG_RING_LEN       16      // records per core
+#define DLOG_STR_MAX        33      // room for an SSID
+#define DLOG_FLUSH_MS       200     // formatter also wakes on its own this often
+
+typedef enum {
+    DLOG_WIFI_FAST_FAIL,
+    DLOG_WIFI_GOT_IP,
+    DLOG_WIFI_TIME_TO_IP,
+    DLOG_WIFI_CANDIDATE,
+    DLOG_WIFI_CONNECTING,
+    DLOG_WIFI_FAST_HINT,
+    DLOG_WIFI_NEXT_RECONNECT,
+    DLOG_WIFI_RETRY,
+    DLOG_SCAN_DONE,
+    DLOG_BLE_SSID,
+    DLOG_BLE_PASS,
+    DLOG_BLE_HANDOFF,
+    DLOG_BLE_TLV_REJECTED,
+    DLOG_BLE_CREDS,
+    DLOG_BLE_STATUS_NO_MBUF,
+    DLOG_BLE_STATUS_FAILED,
+    DLOG_BLE_CONNECTED,
+    DLOG_BLE_MTU,
+    DLOG_BLE_SUBSCRIBE,
+    DLOG_BLE_DISCONNECT,
+    DLOG_BLE_ADV_PHASE_END,
+    DLOG_BLE_ADV_START,
+    DLOG_WEB_CREDS,
+    DLOG_MSG_COUNT,
+} dlog_msg_t;
+
+// Callbacks whose run time is tracked, to compare deferred and synchronous logging
+typedef enum {
+    DLOG_CB_WIFI_EVENT,
+    DLOG_CB_GATT,
+    DLOG_CB_HTTPD,
+    DLOG_CB_COUNT,
+} dlog_cb_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+} dlog_cb_stats_t;
+
+/**
+ * @brief Start the formatting task. Records made earlier are kept and printed once it runs.
+ */
+esp_err_t dlog_init(void);
+
+/**
+ * @brief Record a message. Never blocks; if this core's ring is full the message is counted as dropped.
+ * @param str Copied (truncated to DLOG_STR_MAX - 1), or NULL. Messages declared secret store only
+ *            the string's length, so the value never reaches the ring or the UART.
+ */
+void dlog_str(dlog_msg_t msg, const char *str, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+#define dlog(msg, a0, a1, a2, a3) dlog_str((msg), NULL, (a0), (a1), (a2), (a3))
+
+/**
+ * @brief Messages lost to full rings since boot.
+ */
+uint32_t dlog_get_dropped(void);
+
+/**
+ * @brief Account one callback run that started at start_us (esp_timer time).
+ */
+void dlog_time_callback(dlog_cb_t cb, int64_t start_us);
+
+void dlog_get_callback_stats(dlog_cb_t cb, dlog_cb_stats_t *stats);
+
+const char *dlog_callback_name(dlog_cb_t cb);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef FORM_PARSER_H
+#define FORM_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Single-pass tokenizer for application/x-www-form-urlencoded data.
+ *        Keys and values are percent/plus-decoded in place inside the caller's buffer,
+ *        so no extra buffers are needed; decoded text is never longer than its encoding.
+ */
+typedef struct {
+    char *cur;
+    char *end;
+} form_parser_t;
+
+/**
+ * @brief Start parsing len bytes of buf (which need not be NUL terminated).
+ */
+void form_parser_init(form_parser_t *parser, char *buf, size_t len);
+
+/**
+ * @brief Decode the next key=value pair in place.
+ * @param key_len/value_len Decoded lengths (values may contain %00, so don't rely on strlen).
+ * @return false when the input is exhausted. A pair without '=' yields an empty value.
+ */
+bool form_parser_next(form_parser_t *parser, char **key, size_t *key_len, char **value, size_t *value_len);
+
+/**
+ * @brief Value of a single hex digit, or -1.
+ */
+int form_hex_value(char c);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef PROV_TLV_H
+#define PROV_TLV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Credential payload written to the combined BLE characteristic in one ATT (long) write:
+ *
+ *   version(1) { type(1) len(1) value(len) } ...
+ *
+ * Unknown types are skipped so newer clients can add fields; repeated known types are rejected.
+ */
+#define PROV_TLV_VERSION      0x01
+
+#define PROV_TLV_SSID         0x01    // 1..32 bytes, required
+#define PROV_TLV_PASSPHRASE   0x02    // 8..63 bytes (or 64 hex digits)
+#define PROV_TLV_PSK          0x03    // 32 raw bytes, instead of a passphrase
+#define PROV_TLV_BSSID        0x04    // 6 bytes, optional hint
+
+// Version byte plus every known field at its maximum length
+#define PROV_TLV_MAX_LEN      (1 + (2 + 32) + (2 + 64) + (2 + 6))
+
+typedef enum {
+    PROV_TLV_OK = 0,
+    PROV_TLV_ERR_VERSION,       // unsupported version byte
+    PROV_TLV_ERR_TRUNCATED,     // a field runs past the end of the payload
+    PROV_TLV_ERR_FIELD,         // bad length, duplicate field or passphrase together with a PSK
+    PROV_TLV_ERR_MISSING,       // no SSID
+    PROV_TLV_ERR_NO_SPACE,      // encode buffer too small
+} prov_tlv_err_t;
+
+/**
+ * @brief Decoded credentials. Open networks have neither a passphrase nor a PSK.
+ */
+typedef struct {
+    char ssid[33];
+    char passphrase[65];
+    uint8_t psk[32];
+    uint8_t bssid[6];
+    bool has_psk;
+    bool has_bssid;
+} prov_tlv_creds_t;
+
+/**
+ * @brief Validate and decode a credential payload. creds is zeroed first.
+ */
+prov_tlv_err_t prov_tlv_decode(const uint8_t *buf, size_t len, prov_tlv_creds_t *creds);
+
+/**
+ * @brief Encode creds (the inverse of prov_tlv_decode, for clients and tooling).
+ * @param out_len Bytes written on success.
+ */
+prov_tlv_err_t prov_tlv_encode(const prov_tlv_creds_t *creds, uint8_t *buf, size_t buf_len, size_t *out_len);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef PROV_WORKER_H
+#define PROV_WORKER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "task_plan.h"
+
+#define PROV_WORKER_QUEUE_LEN     2
+// Delay between reporting success and tearing the transports down
+#define PROV_WORKER_RESULT_GRACE_MS 3000
+
+typedef enum {
+    PROV_SOURCE_WEB,
+    PROV_SOURCE_BLE,
+} prov_source_t;
+
+typedef enum {
+    PROV_STATE_IDLE,
+    PROV_STATE_APPLYING,
+    PROV_STATE_CONNECTED,
+    PROV_STATE_FAILED,
+} prov_state_t;
+
+/**
+ * @brief Outcome of the last credentials handled by the worker (polled by the portal).
+ */
+typedef struct {
+    prov_state_t state;
+    prov_source_t source;
+    char ssid[33];
+    uint8_t reason;         // disconnect reason when state is PROV_STATE_FAILED
+    esp_ip4_addr_t ip;      // valid when state is PROV_STATE_CONNECTED
+} prov_status_t;
+
+/**
+ * @brief Create the provisioning worker task and its queue. Safe to call more than once.
+ */
+esp_err_t prov_worker_start(void);
+
+/**
+ * @brief Hand received credentials to the worker and return immediately.
+ *        The NVS commit, live apply and transport teardown happen on the worker task.
+ * @param bssid Optional 6-byte AP hint, or NULL.
+ * @return ESP_ERR_INVALID_STATE if the worker isn't running, ESP_ERR_NO_MEM if the queue is full.
+ */
+esp_err_t prov_worker_post_credentials(prov_source_t source, const char *ssid, const char *password,
+                                      const uint8_t *bssid);
+
+/**
+ * @brief Snapshot of the worker's current status.
+ */
+void prov_worker_get_status(prov_status_t *status);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RES_MONITOR_H
+#define RES_MONITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// How often stacks are sampled while the provisioning portal is up
+#define RES_MONITOR_PERIOD_MS      500
+// Headroom added to the deepest stack use seen before a size is suggested
+#define RES_MONITOR_STACK_MARGIN   768
+// Suggested sizes are rounded up to this
+#define RES_MONITOR_STACK_ALIGN    256
+// Tasks captured by the CPU-share snapshots (needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+#define RES_MONITOR_MAX_TASKS      32
+
+typedef struct {
+    const char *task;           // FreeRTOS task name
+    uint32_t stack_size;        // configured stack, bytes
+    uint32_t min_free;          // lowest high-water mark seen, bytes (valid when samples > 0)
+    uint32_t samples;           // times the task was found alive
+} res_monitor_task_t;
+
+typedef struct {
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;
+    uint32_t largest_block;
+    uint32_t free_blocks;
+    uint8_t fragmentation_pct;  // share of free heap not usable as one allocation
+} res_monitor_heap_t;
+
+/**
+ * @brief Start sampling task stacks every RES_MONITOR_PERIOD_MS. Call while the portal is up.
+ *        Also takes the run-time baseline the CPU-share report is measured from.
+ */
+void res_monitor_start(void);
+
+/**
+ * @brief Stop periodic sampling and close the CPU-share window. Call before the tracked tasks are torn down.
+ */
+void res_monitor_stop(void);
+
+/**
+ * @brief Take one sample of every tracked task that is currently running. Safe from any task,
+ *        but only call where none of the tracked tasks can be deleted concurrently.
+ */
+void res_monitor_sample(void);
+
+/**
+ * @brief Consistent copy of a tracked task's figures, by index.
+ * @return false past the last one.
+ */
+bool res_monitor_get_task(size_t index, res_monitor_task_t *task);
+
+/**
+ * @brief Smallest stack that keeps RES_MONITOR_STACK_MARGIN bytes spare at the deepest use seen,
+ *        or 0 if the task was never sampled.
+ */
+uint32_t res_monitor_suggest_stack(const res_monitor_task_t *task);
+
+void res_monitor_get_heap(res_monitor_heap_t *heap);
+
+/**
+ * @brief Log every tracked task with its suggested stack size, heap fragmentation and, with
+ *        run-time stats enabled, each task's CPU share between res_monitor_start() and res_monitor_stop().
+ */
+void res_monitor_log_report(void);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SCAN_CACHE_H
+#define SCAN_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define SCAN_CACHE_MAX_AP           20      // raw records fetched from the driver per scan
+#define SCAN_CACHE_MAX_ENTRIES      16      // distinct SSIDs kept
+#define SCAN_CACHE_MAX_AGE_MS       30000   // older results are considered stale
+#define SCAN_CACHE_MIN_INTERVAL_MS  10000   // portal-triggered scans are rate limited to this
+
+/**
+ * @brief Strongest BSSID seen for one SSID.
+ */
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t authmode;
+} scan_cache_entry_t;
+
+/**
+ * @brief Start a scan without waiting for it.
+ * @param force Skip the rate limit (used by STA reconnects); portal requests pass false.
+ * @return ESP_OK if a scan is running (started now or already in progress),
+ *         ESP_ERR_INVALID_STATE if rate limited.
+ */
+esp_err_t scan_cache_start(bool force);
+
+/**
+ * @brief Pull the finished scan from the driver into the table. Call on WIFI_EVENT_SCAN_DONE.
+ */
+void scan_cache_on_scan_done(void);
+
+/**
+ * @brief Copy entry index (0 = strongest) out of the table.
+ * @return false past the last entry.
+ */
+bool scan_cache_get(int index, scan_cache_entry_t *entry);
+
+/**
+ * @brief Milliseconds since the table was filled, or -1 if it never was.
+ */
+int32_t scan_cache_age_ms(void);
+
+/**
+ * @brief True if results are younger than SCAN_CACHE_MAX_AGE_MS.
+ */
+bool scan_cache_is_fresh(void);
+
+/**
+ * @brief True while a scan started through this module is in flight.
+ */
+bool scan_cache_is_scanning(void);
+
+/**
+ * @brief Abort an in-flight scan, keeping the previous results.
+ */
+void scan_cache_stop(void);
+
+#endif
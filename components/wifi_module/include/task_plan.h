@@ -0,0 +1,104 @@
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+/*
+ * Where every task this component creates runs: core, priority and stack, in one place.
+ *
+ * Core 0 belongs to the radios. The WiFi driver, the BT controller, the NimBLE host
+ * (CONFIG_BT_NIMBLE_PINNED_TO_CORE) and esp_timer (CONFIG_ESP_TIMER_TASK_AFFINITY) are pinned
+ * there by sdkconfig, so BLE timing only competes with the WiFi stack.
+ * The portal's own work (httpd, its async workers, DNS, the provisioning worker and teardown)
+ * is pinned to core 1, where a burst of page loads can't delay a GATT response.
+ * lwIP's tcpip task floats (CONFIG_LWIP_TCPIP_TASK_AFFINITY) and follows the load.
+ * Priorities keep the order on core 1: whoever applies credentials beats whoever serves pages,
+ * and the accept loop beats the workers it feeds.
+ *
+ * res_monitor_log_report() prints per-task CPU share for a provisioning session when built with
+ * sdkconfig.profiling, to check this plan against real load; tools/cpu_share.py tabulates it.
+ */
+
+#define TASK_PLAN_RADIO_CORE    0
+#define TASK_PLAN_APP_CORE      (portNUM_PROCESSORS > 1 ? 1 : 0)
+
+// Provisioning worker: saves and applies credentials
+#ifndef PROV_WORKER_CORE
+#define PROV_WORKER_CORE          TASK_PLAN_APP_CORE
+#endif
+#ifndef PROV_WORKER_PRIORITY
+#define PROV_WORKER_PRIORITY      6
+#endif
+#ifndef PROV_WORKER_STACK_SIZE
+#define PROV_WORKER_STACK_SIZE    4096
+#endif
+
+// httpd accept/dispatch loop
+#ifndef WEB_SERVER_CORE
+#define WEB_SERVER_CORE           TASK_PLAN_APP_CORE
+#endif
+#ifndef WEB_SERVER_PRIORITY
+#define WEB_SERVER_PRIORITY       5
+#endif
+// /debug/resources suggests a tighter value once a provisioning run has been sampled
+#ifndef WEB_SERVER_STACK_SIZE
+#define WEB_SERVER_STACK_SIZE     8192
+#endif
+
+// Async workers finishing slow portal responses
+#ifndef WEB_ASYNC_CORE
+#define WEB_ASYNC_CORE            TASK_PLAN_APP_CORE
+#endif
+#ifndef WEB_ASYNC_PRIORITY
+#define WEB_ASYNC_PRIORITY        4
+#endif
+#ifndef WEB_ASYNC_STACK_SIZE
+#define WEB_ASYNC_STACK_SIZE      4096
+#endif
+
+// Captive-portal DNS responder
+#ifndef CAPTIVE_DNS_CORE
+#define CAPTIVE_DNS_CORE          TASK_PLAN_APP_CORE
+#endif
+#ifndef CAPTIVE_DNS_PRIORITY
+#define CAPTIVE_DNS_PRIORITY      4
+#endif
+#ifndef CAPTIVE_DNS_STACK_SIZE
+#define CAPTIVE_DNS_STACK_SIZE    3072
+#endif
+
+// Connectivity probe
+#ifndef CONN_CHECK_CORE
+#define CONN_CHECK_CORE           TASK_PLAN_APP_CORE
+#endif
+#ifndef CONN_CHECK_PRIORITY
+#define CONN_CHECK_PRIORITY       3
+#endif
+#ifndef CONN_CHECK_STACK_SIZE
+#define CONN_CHECK_STACK_SIZE     4096
+#endif
+
+// Provisioning teardown (httpd_stop, NimBLE deinit)
+#ifndef TEARDOWN_TASK_CORE
+#define TEARDOWN_TASK_CORE        TASK_PLAN_APP_CORE
+#endif
+#ifndef TEARDOWN_TASK_PRIORITY
+#define TEARDOWN_TASK_PRIORITY    2
+#endif
+#ifndef TEARDOWN_TASK_STACK_SIZE
+#define TEARDOWN_TASK_STACK_SIZE  4096
+#endif
+
+// Deferred log formatter: background work, either core
+#ifndef DLOG_TASK_CORE
+#define DLOG_TASK_CORE            tskNO_AFFINITY
+#endif
+#ifndef DLOG_TASK_PRIORITY
+#define DLOG_TASK_PRIORITY        1
+#endif
+#ifndef DLOG_TASK_STACK
+#define DLOG_TASK_STACK           3072
+#endif
+
+#endif
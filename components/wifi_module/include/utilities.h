@@ -1,9 +1,28 @@
 #ifndef T_UTILITIES_H
 #define T_UTILITIES_H
 
+#include "esp_err.h"
+#include "task_plan.h"
+
 //A generic callback for stop actions
 typedef void (*stop_action_cb_t) (void);
 
+// Static allocation: the provisioning timer, the teardown task and the provisioning worker live in
+// .bss instead of the heap, so re-entering provisioning never allocates or frees. The teardown task
+// then stays parked between runs rather than being deleted, keeping its stack reserved for good.
+#ifndef PROV_STATIC_ALLOC
+#define PROV_STATIC_ALLOC         0
+#endif
+
+// Size of the stop-action table; register_stop_component() fails past this
+#ifndef STOP_COMPONENTS_MAX
+#define STOP_COMPONENTS_MAX       5
+#endif
+
+// Registered stop actions run on a task of their own, placed by task_plan.h
+// Pause after each step so the idle task can free the stacks of deleted tasks before heap is sampled
+#define TEARDOWN_SETTLE_MS        20
+
 /**
  * @brief Starts a global provisioning timer.
  * @param timeout_min Minutes until the timer expires.
@@ -12,9 +31,19 @@ void start_provisioning_manager(int timeout_min);
 
 /**
  * @brief Register a module (WiFi, BLE, WebServer) to be stopped on timeout.
+ *        Components are stopped in registration order.
+ * @param name Shown in the per-step heap report.
  * @param cb The function to call when time is up.
+ * @return ESP_ERR_NO_MEM once STOP_COMPONENTS_MAX components are registered.
+ */
+esp_err_t register_stop_component(const char *name, stop_action_cb_t cb);
+
+/**
+ * @brief Stop every registered component now (timeout or successful provisioning).
+ *        Returns immediately; the steps run on their own task and log free / minimum-free heap
+ *        before and after each one.
  */
-void register_stop_component(stop_action_cb_t cb);
+void shutdown_provisioning_components(void);
 
 /**
  * @brief Cancels the timer (call this when credentials are successfully received).
@@ -2,8 +2,56 @@
 #define WEB_SERVER_H
 
 #include "esp_err.h"
+#include "task_plan.h"
+
+// Portal assets are sent from flash in slices of this size
+#define PORTAL_CHUNK_SIZE 1436
+
+// Longest accepted /save form: a fully percent-encoded 32-byte SSID and 64-byte passphrase
+#define FORM_MAX_LEN      320
+
+// Receive timeouts (WEB_RECV_TIMEOUT_S each) tolerated while reading a /save body before a 408
+#define FORM_RECV_MAX_TIMEOUTS 2
+
+// Stack buffer /scan builds its JSON in before each chunk is sent
+#define SCAN_JSON_CHUNK   512
+
+// Stack buffer /metrics formats each block of its Prometheus text in
+#define METRICS_CHUNK     512
+
+// Stack buffer /debug/resources builds its JSON in before each chunk is sent
+#define DEBUG_JSON_CHUNK  384
+
+// Where captive-portal probes are redirected; the SoftAP's default address
+#define PORTAL_URL        "http://192.168.4.1/"
+
+// Room for the asset routes, /save (GET and POST), /status, /scan, /metrics, /debug/resources
+// and the captive-portal probe URLs
+#define WEB_MAX_URI_HANDLERS 24
+
+// Slow responses (portal assets, /metrics) are finished on these workers so the httpd task can
+// accept the next request; 0 serves everything on the httpd task as before
+#ifndef WEB_ASYNC_WORKERS
+#define WEB_ASYNC_WORKERS     2
+#endif
+// Requests waiting for a worker; past this the client gets a 503. Queued and running requests each
+// hold a socket, so together they must stay below the socket budget or nothing new gets accepted
+#define WEB_ASYNC_QUEUE_LEN   2
+
+// Socket budget: phones open several parallel connections, so allow a few per SoftAP client,
+// capped by what lwIP has left after httpd's own 3 sockets, the DNS responder and the probe
+#define WEB_SOCKETS_PER_CLIENT 2
+#define WEB_SOCKETS_RESERVED   5
+
+// Idle keep-alive connections are probed after this long and dropped after the probes fail;
+// recv/send timeouts bound how long one stalled client can hold a socket or a worker
+#define WEB_KEEPALIVE_IDLE_S      5
+#define WEB_KEEPALIVE_INTERVAL_S  2
+#define WEB_KEEPALIVE_COUNT       3
+#define WEB_RECV_TIMEOUT_S        5
+#define WEB_SEND_TIMEOUT_S        5
 
 void start_webserver(void);
-void url_decode(char *dst, const char *src);
+void stop_webserver(void);
 
 #endif
@@ -4,18 +4,113 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
 #include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "wifi_policy.h"
+#include "wifi_psk.h"
 
 #define MAX_RETRY      5
 
+// How long a live credential apply waits for an IP before reporting back
+#define WIFI_APPLY_TIMEOUT_MS 15000
+
+// Store the derived WPA2 PSK instead of the passphrase so boots skip PBKDF2 (4096 rounds)
+#ifndef WIFI_STORE_PSK
+#define WIFI_STORE_PSK        1
+#endif
+
+// Lean boot (opt-in): with saved credentials, give the BT controller's reserved RAM back to the heap at
+// startup. The release lasts until reboot, so if the saved networks later fail the fallback portal is
+// web-only: BLE re-provisioning is lost. Compare the "Boot (...)" log line of both builds first.
+#ifndef WIFI_LEAN_BOOT
+#define WIFI_LEAN_BOOT        0
+#endif
+
+// QEMU benchmark build (tools/qemu_bench.py): there is no radio under QEMU, so the portal is served over
+// the emulated openeth NIC instead of the SoftAP, without captive DNS or BLE. Set with -DWIFI_PROV_QEMU_ETH=1
+// together with sdkconfig.qemu; never for a device image.
+#ifndef WIFI_PROV_QEMU_ETH
+#define WIFI_PROV_QEMU_ETH    0
+#endif
+
 //Define access point credentials
 #define ESP_WIFI_AP_SSID      "ESP32_Config_Node"
 #define ESP_WIFI_AP_PASS      "12345678"
 #define ESP_MAX_STA_CONN      4
 
+ESP_EVENT_DECLARE_BASE(WIFI_MODULE_EVENT);
+
+typedef enum {
+    WIFI_MODULE_EVENT_RECONNECT,     // backoff timer expired, scan for known networks again
+    WIFI_MODULE_EVENT_PROVISIONED,   // new credentials work, close the provisioning transports
+    WIFI_MODULE_EVENT_APPLY,         // save provisioned credentials and join them (see wifi_module_apply_credentials)
+    WIFI_MODULE_EVENT_APPLY_CONNECT, // connect with the applied config, queued behind the old attempt's events
+    WIFI_MODULE_EVENT_APPLY_TIMEOUT, // the transport stopped waiting; hand the network back to the scheduler
+    WIFI_MODULE_EVENT_PORTAL_CLOSED, // the teardown task stopped the portal's transports; drop the AP
+} wifi_module_event_t;
+
+typedef struct {
+    uint32_t attempts;              // scheduled reconnect rounds started
+    uint32_t failed_rounds;         // rounds in which no known network could be joined
+    uint32_t successes;             // times an IP was obtained
+    uint32_t retry_count;           // consecutive failed rounds since the last success
+    uint32_t current_backoff_ms;    // delay chosen for the pending retry, 0 when connected
+} wifi_reconnect_stats_t;
+
+typedef struct {
+    uint8_t disconnect_reason;      // driver reason code when the connect failed, 0 on timeout
+    esp_ip4_addr_t ip;              // address obtained on success
+} wifi_apply_result_t;
+
+/**
+ * @brief What is stored for a network: the derived PSK (WIFI_STORE_PSK) or the passphrase as given.
+ */
+typedef struct {
+    uint8_t secret[64];             // PSK or passphrase, no terminator
+    uint8_t len;
+    bool is_psk;
+} wifi_secret_t;
 
 void wifi_init_softap(void);
 void wifi_module_init(void);
+
+/**
+ * @brief Turn a passphrase into what gets stored. With WIFI_STORE_PSK this runs PBKDF2 (4096 rounds,
+ *        hundreds of ms), so call it on the provisioning task, never on the default event loop.
+ */
+esp_err_t wifi_module_prepare_secret(const char* ssid, const char* password, wifi_secret_t *secret);
+
+/**
+ * @brief Prepare and store credentials. Blocks like wifi_module_prepare_secret().
+ */
 esp_err_t save_wifi_credentials(const char* ssid, const char* password);
-void stop_provisioning_timer(void);
+
+/**
+ * @brief Snapshot of the reconnect scheduler counters.
+ */
+void wifi_module_get_reconnect_stats(wifi_reconnect_stats_t *stats);
+
+/**
+ * @brief Save credentials and join the network on the running STA interface, without a restart.
+ *        Blocks for up to WIFI_APPLY_TIMEOUT_MS; the work itself runs on the default event loop,
+ *        so this must not be called from an event handler.
+ * @param secret From wifi_module_prepare_secret(), so the event loop never runs PBKDF2.
+ * @param bssid Optional AP to join (NULL lets the driver pick the best one for the SSID).
+ * @return ESP_OK once an IP is obtained, ESP_FAIL if the AP rejected us (see result->disconnect_reason),
+ *         ESP_ERR_TIMEOUT if nothing happened in time (retries continue in the background),
+ *         anything else if the driver could not take the new config (fall back to a restart).
+ */
+esp_err_t wifi_module_apply_credentials(const char* ssid, const wifi_secret_t *secret, const uint8_t *bssid,
+                                       wifi_apply_result_t *result);
+
+/**
+ * @brief Close the portal and BLE transports after a successful apply. Safe to call from their handlers.
+ */
+void wifi_module_finish_provisioning(void);
+
+/**
+ * @brief Short, user-facing description of a disconnect reason.
+ */
+const char *wifi_module_reason_str(uint8_t reason);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef WIFI_POLICY_H
+#define WIFI_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Connection policy decisions, kept free of ESP-IDF and FreeRTOS so they build and run
+ * on a host compiler as-is. Anything random or time dependent is passed in by the caller.
+ */
+
+// Networks whose RSSI falls in the same bucket are ordered by recency instead
+#define WIFI_RSSI_BUCKET_DB   8
+
+// Reconnect backoff: base * 2^attempt, capped, with half of each delay randomised
+#define WIFI_BACKOFF_BASE_MS  1000
+#define WIFI_BACKOFF_MAX_MS   60000
+
+/**
+ * @brief Equal-jitter backoff: half the exponential delay is fixed, the other half random.
+ * @param random Any 32-bit random value (esp_random() on target).
+ */
+uint32_t wifi_policy_backoff_ms(int attempt, uint32_t random);
+
+/**
+ * @brief Whether network a should be tried before network b.
+ *        Stronger signal first; within the same RSSI bucket, the most recently joined wins.
+ * @param last_a/last_b Success stamps from the credential table.
+ */
+bool wifi_policy_rank_before(int8_t rssi_a, uint32_t last_a, int8_t rssi_b, uint32_t last_b);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef WIFI_PSK_H
+#define WIFI_PSK_H
+
+#include <stdint.h>
+
+/*
+ * WPA2 passphrase to PSK, kept free of ESP-IDF so the host tests can check it against the
+ * IEEE 802.11i test vectors with the host's mbedtls (see host_test/).
+ */
+
+#define WIFI_PSK_LEN          32
+
+/**
+ * @brief PSK = PBKDF2-HMAC-SHA1(passphrase, ssid, 4096 rounds, 32 bytes).
+ * @return 0 on success, otherwise the mbedtls error code.
+ */
+int wifi_psk_derive(const char *ssid, const char *passphrase, uint8_t psk[WIFI_PSK_LEN]);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef WIFI_STORAGE_H
+#define WIFI_STORAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define WIFI_CRED_NVS_NAMESPACE   "storage"
+#define WIFI_CRED_NVS_KEY         "wifi_cred"
+#define WIFI_CRED_RECORD_MAGIC    0x5743   // "WC"
+#define WIFI_CRED_RECORD_VERSION  2
+
+// Number of networks remembered; the least recently joined one is evicted when full
+#ifndef WIFI_MAX_SAVED_NETWORKS
+#define WIFI_MAX_SAVED_NETWORKS   4
+#endif
+
+// Entry flags
+#define WIFI_CRED_F_PSK           0x01     // secret holds a 32-byte precomputed PSK
+#define WIFI_CRED_F_FAST_VALID    0x02     // bssid/channel/authmode hold the last AP we got an IP from
+
+/**
+ * @brief One remembered network.
+ *        last_success is a stamp from the table's success counter (there is no RTC at boot),
+ *        so a higher value means joined more recently; 0 means never joined.
+ */
+typedef struct __attribute__((packed)) {
+    char     ssid[33];
+    uint8_t  flags;
+    uint8_t  secret_len;
+    uint8_t  secret[64];    // passphrase (no terminator) or PSK
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    uint8_t  authmode;
+    uint32_t last_success;
+} wifi_cred_entry_t;
+
+/**
+ * @brief All remembered networks, stored as one CRC-checked NVS blob.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  version;
+    uint8_t  count;
+    uint32_t success_seq;   // last stamp handed out
+    wifi_cred_entry_t entries[WIFI_MAX_SAVED_NETWORKS];
+    uint32_t crc32;         // over every byte before this field
+} wifi_cred_table_t;
+
+/**
+ * @brief Read the credential table with a single NVS lookup.
+ *        Migrates the wifi_ssid/wifi_pass keys written by older firmware.
+ * @return ESP_ERR_NVS_NOT_FOUND if nothing is stored, ESP_ERR_INVALID_CRC if the table is corrupt.
+ */
+esp_err_t wifi_storage_load(wifi_cred_table_t *table);
+
+/**
+ * @brief Fill in magic/version/CRC and write the table as a single blob + commit.
+ */
+esp_err_t wifi_storage_save(wifi_cred_table_t *table);
+
+/**
+ * @brief Find a remembered network by SSID.
+ * @return The entry, or NULL if the SSID is unknown.
+ */
+wifi_cred_entry_t *wifi_storage_find(wifi_cred_table_t *table, const char *ssid);
+
+/**
+ * @brief Find or add the entry for an SSID, evicting the least recently joined network if the table is full.
+ *        A reused entry is cleared except for its SSID.
+ */
+wifi_cred_entry_t *wifi_storage_add(wifi_cred_table_t *table, const char *ssid);
+
+/**
+ * @brief Stamp an entry as the most recently joined network.
+ */
+void wifi_storage_mark_success(wifi_cred_table_t *table, wifi_cred_entry_t *entry);
+
+/**
+ * @brief Number of NVS commits issued by this module since boot.
+ */
+uint32_t wifi_storage_get_write_count(void);
+
+#endif
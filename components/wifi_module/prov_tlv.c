@@ -0,0 +1,111 @@
+#include <string.h>
+#include "prov_tlv.h"
+
+prov_tlv_err_t prov_tlv_decode(const uint8_t *buf, size_t len, prov_tlv_creds_t *creds) {
+    uint8_t seen = 0;
+    size_t pos = 1;
+
+    memset(creds, 0, sizeof(*creds));
+    if (len < 1 || buf[0] != PROV_TLV_VERSION) {
+        return PROV_TLV_ERR_VERSION;
+    }
+
+    while (pos < len) {
+        if (len - pos < 2) {
+            return PROV_TLV_ERR_TRUNCATED;
+        }
+        uint8_t type = buf[pos];
+        uint8_t field_len = buf[pos + 1];
+        const uint8_t *value = &buf[pos + 2];
+        pos += 2;
+        if (len - pos < field_len) {
+            return PROV_TLV_ERR_TRUNCATED;
+        }
+        pos += field_len;
+
+        if (type >= 8) {
+            continue;   // from a newer client, not ours to interpret
+        }
+        if (seen & (1u << type)) {
+            return PROV_TLV_ERR_FIELD;
+        }
+        seen |= (1u << type);
+
+        switch (type) {
+        case PROV_TLV_SSID:
+            if (field_len < 1 || field_len >= sizeof(creds->ssid) || memchr(value, '\0', field_len) != NULL) {
+                return PROV_TLV_ERR_FIELD;
+            }
+            memcpy(creds->ssid, value, field_len);
+            break;
+        case PROV_TLV_PASSPHRASE:
+            if (field_len < 8 || field_len >= sizeof(creds->passphrase) || memchr(value, '\0', field_len) != NULL) {
+                return PROV_TLV_ERR_FIELD;
+            }
+            memcpy(creds->passphrase, value, field_len);
+            break;
+        case PROV_TLV_PSK:
+            if (field_len != sizeof(creds->psk)) {
+                return PROV_TLV_ERR_FIELD;
+            }
+            memcpy(creds->psk, value, field_len);
+            creds->has_psk = true;
+            break;
+        case PROV_TLV_BSSID:
+            if (field_len != sizeof(creds->bssid)) {
+                return PROV_TLV_ERR_FIELD;
+            }
+            memcpy(creds->bssid, value, field_len);
+            creds->has_bssid = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!(seen & (1u << PROV_TLV_SSID))) {
+        return PROV_TLV_ERR_MISSING;
+    }
+    if ((seen & (1u << PROV_TLV_PASSPHRASE)) && creds->has_psk) {
+        return PROV_TLV_ERR_FIELD;
+    }
+    return PROV_TLV_OK;
+}
+
+static bool put_field(uint8_t *buf, size_t buf_len, size_t *pos, uint8_t type, const void *value, size_t len) {
+    if (buf_len - *pos < 2 + len) {
+        return false;
+    }
+    buf[(*pos)++] = type;
+    buf[(*pos)++] = (uint8_t)len;
+    memcpy(&buf[*pos], value, len);
+    *pos += len;
+    return true;
+}
+
+prov_tlv_err_t prov_tlv_encode(const prov_tlv_creds_t *creds, uint8_t *buf, size_t buf_len, size_t *out_len) {
+    size_t ssid_len = strnlen(creds->ssid, sizeof(creds->ssid));
+    size_t pass_len = strnlen(creds->passphrase, sizeof(creds->passphrase));
+    size_t pos = 0;
+
+    if (ssid_len == 0) {
+        return PROV_TLV_ERR_MISSING;
+    }
+    if (ssid_len >= sizeof(creds->ssid) || pass_len >= sizeof(creds->passphrase) ||
+        (pass_len > 0 && (pass_len < 8 || creds->has_psk))) {
+        return PROV_TLV_ERR_FIELD;
+    }
+    if (buf_len < 1) {
+        return PROV_TLV_ERR_NO_SPACE;
+    }
+    buf[pos++] = PROV_TLV_VERSION;
+
+    if (!put_field(buf, buf_len, &pos, PROV_TLV_SSID, creds->ssid, ssid_len) ||
+        (pass_len > 0 && !put_field(buf, buf_len, &pos, PROV_TLV_PASSPHRASE, creds->passphrase, pass_len)) ||
+        (creds->has_psk && !put_field(buf, buf_len, &pos, PROV_TLV_PSK, creds->psk, sizeof(creds->psk))) ||
+        (creds->has_bssid && !put_field(buf, buf_len, &pos, PROV_TLV_BSSID, creds->bssid, sizeof(creds->bssid)))) {
+        return PROV_TLV_ERR_NO_SPACE;
+    }
+    *out_len = pos;
+    return PROV_TLV_OK;
+}
@@ -0,0 +1,143 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "prov_worker.h"
+#include "wifi_module.h"
+#include "utilities.h"
+#include "ble_provisioning.h"
+
+static const char *TAG = "PROV_WORKER";
+
+typedef struct {
+    prov_source_t source;
+    char ssid[33];
+    char password[65];
+    uint8_t bssid[6];
+    bool has_bssid;
+} prov_request_t;
+
+static StaticQueue_t s_queue_storage;
+static uint8_t s_queue_buffer[PROV_WORKER_QUEUE_LEN * sizeof(prov_request_t)];
+static QueueHandle_t s_queue = NULL;
+static TaskHandle_t s_task = NULL;
+#if PROV_STATIC_ALLOC
+static StaticTask_t s_task_storage;
+static StackType_t s_task_stack[PROV_WORKER_STACK_SIZE];
+#endif
+
+static portMUX_TYPE s_status_lock = portMUX_INITIALIZER_UNLOCKED;
+static prov_status_t s_status;
+
+static void set_status(const prov_status_t *status) {
+    portENTER_CRITICAL(&s_status_lock);
+    s_status = *status;
+    portEXIT_CRITICAL(&s_status_lock);
+}
+
+static void handle_request(prov_request_t *req) {
+    prov_status_t status = { .state = PROV_STATE_APPLYING, .source = req->source };
+    strncpy(status.ssid, req->ssid, sizeof(status.ssid) - 1);
+    set_status(&status);
+
+    stop_provisioning_manager();
+
+    // PBKDF2 runs here, not on the default event loop where the save and connect happen
+    wifi_secret_t secret;
+    wifi_apply_result_t result;
+    esp_err_t err = wifi_module_prepare_secret(req->ssid, req->password, &secret);
+    memset(req->password, 0, sizeof(req->password));
+    if (err == ESP_OK) {
+        err = wifi_module_apply_credentials(req->ssid, &secret, req->has_bssid ? req->bssid : NULL, &result);
+    } else {
+        memset(&result, 0, sizeof(result));
+    }
+    memset(&secret, 0, sizeof(secret));
+
+    if (err == ESP_OK) {
+        status.state = PROV_STATE_CONNECTED;
+        status.ip = result.ip;
+        set_status(&status);
+        ESP_LOGI(TAG, "Connected with new credentials, closing provisioning");
+        // Leave the portal up long enough for the client to read the result
+        vTaskDelay(pdMS_TO_TICKS(PROV_WORKER_RESULT_GRACE_MS));
+        wifi_module_finish_provisioning();
+    } else if (err == ESP_FAIL || err == ESP_ERR_TIMEOUT) {
+        status.state = PROV_STATE_FAILED;
+        status.reason = result.disconnect_reason;
+        set_status(&status);
+        ESP_LOGW(TAG, "New credentials did not work: %s", wifi_module_reason_str(result.disconnect_reason));
+        // Give the user the rest of the provisioning window to fix it
+        start_provisioning_manager(1);
+    } else {
+        // Fallback: the driver wouldn't take the config live, let a clean boot pick it up
+        ESP_LOGW(TAG, "Live apply unavailable (%s), restarting", esp_err_to_name(err));
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        esp_restart();
+    }
+}
+
+static void prov_worker_task(void *param) {
+    (void)param;
+    prov_request_t req;
+
+    while (1) {
+        if (xQueueReceive(s_queue, &req, portMAX_DELAY) == pdTRUE) {
+            handle_request(&req);
+        }
+    }
+}
+
+esp_err_t prov_worker_start(void) {
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    s_queue = xQueueCreateStatic(PROV_WORKER_QUEUE_LEN, sizeof(prov_request_t), s_queue_buffer, &s_queue_storage);
+#if PROV_STATIC_ALLOC
+    s_task = xTaskCreateStaticPinnedToCore(prov_worker_task, "prov_worker", PROV_WORKER_STACK_SIZE, NULL,
+                                           PROV_WORKER_PRIORITY, s_task_stack, &s_task_storage, PROV_WORKER_CORE);
+#else
+    if (xTaskCreatePinnedToCore(prov_worker_task, "prov_worker", PROV_WORKER_STACK_SIZE, NULL, PROV_WORKER_PRIORITY,
+                                &s_task, PROV_WORKER_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create provisioning worker");
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
+esp_err_t prov_worker_post_credentials(prov_source_t source, const char *ssid, const char *password,
+                                      const uint8_t *bssid) {
+    prov_request_t req = { .source = source };
+
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (strlen(ssid) >= sizeof(req.ssid) || strlen(password) >= sizeof(req.password)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strncpy(req.ssid, ssid, sizeof(req.ssid) - 1);
+    strncpy(req.password, password, sizeof(req.password) - 1);
+    if (bssid != NULL) {
+        memcpy(req.bssid, bssid, sizeof(req.bssid));
+        req.has_bssid = true;
+    }
+
+    // Never block the caller: it is the NimBLE host task or the httpd worker
+    if (xQueueSend(s_queue, &req, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Provisioning queue full, dropping request");
+        return ESP_ERR_NO_MEM;
+    }
+    ble_provisioning_notify_status(BLE_PROV_STATUS_RECEIVED, 0, 0);
+    return ESP_OK;
+}
+
+void prov_worker_get_status(prov_status_t *status) {
+    portENTER_CRITICAL(&s_status_lock);
+    *status = s_status;
+    portEXIT_CRITICAL(&s_status_lock);
+}
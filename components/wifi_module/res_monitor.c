@@ -0,0 +1,180 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "res_monitor.h"
+#include "web_server.h"
+#include "prov_worker.h"
+#include "conn_check.h"
+#include "dlog.h"
+
+static const char *TAG = "RES_MONITOR";
+
+// System tasks are looked up by the names IDF gives them; sizes come from sdkconfig or our own macros
+static res_monitor_task_t s_tasks[] = {
+    { "httpd",       WEB_SERVER_STACK_SIZE,                   0, 0 },
+    { "nimble_host", CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE,   0, 0 },
+    { "Tmr Svc",     CONFIG_FREERTOS_TIMER_TASK_STACK_DEPTH,  0, 0 },
+    { "sys_evt",     CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE, 0, 0 },
+    { "esp_timer",   CONFIG_ESP_TIMER_TASK_STACK_SIZE,        0, 0 },
+    { "prov_worker", PROV_WORKER_STACK_SIZE,                  0, 0 },
+    { "conn_check",  CONN_CHECK_STACK_SIZE,                   0, 0 },
+    { "dlog",        DLOG_TASK_STACK,                         0, 0 },
+};
+
+#define TASK_COUNT (sizeof(s_tasks) / sizeof(s_tasks[0]))
+
+static esp_timer_handle_t s_timer = NULL;
+// s_tasks' samples are taken on the esp_timer, httpd and teardown tasks
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if defined(CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS) && defined(CONFIG_FREERTOS_USE_TRACE_FACILITY)
+#define RES_MONITOR_RUNTIME 1
+// Run-time counters at the start and end of the provisioning session
+static TaskStatus_t s_run_start[RES_MONITOR_MAX_TASKS];
+static TaskStatus_t s_run_end[RES_MONITOR_MAX_TASKS];
+static UBaseType_t s_run_start_count = 0;
+static UBaseType_t s_run_end_count = 0;
+static uint32_t s_run_start_total = 0;
+static uint32_t s_run_end_total = 0;
+
+static uint32_t baseline_counter(UBaseType_t task_number) {
+    for (UBaseType_t i = 0; i < s_run_start_count; i++) {
+        if (s_run_start[i].xTaskNumber == task_number) {
+            return s_run_start[i].ulRunTimeCounter;
+        }
+    }
+    return 0;       // created during the session
+}
+
+// Share of one core each task used during the session; the radio core's tasks and ours side by side
+static void log_runtime_report(void) {
+    uint32_t window = s_run_end_total - s_run_start_total;
+
+    if (s_run_end_count == 0 || window == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "CPU share over %u ms of provisioning (%% of one core):", (unsigned)(window / 1000));
+    for (UBaseType_t i = 0; i < s_run_end_count; i++) {
+        const TaskStatus_t *t = &s_run_end[i];
+        uint32_t used = t->ulRunTimeCounter - baseline_counter(t->xTaskNumber);
+        if (used == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "  %-16s prio %2u  %5.1f%%", t->pcTaskName, (unsigned)t->uxCurrentPriority,
+                 100.0 * used / window);
+    }
+}
+#else
+#define RES_MONITOR_RUNTIME 0
+#endif
+
+void res_monitor_sample(void) {
+    for (size_t i = 0; i < TASK_COUNT; i++) {
+        TaskHandle_t handle = xTaskGetHandle(s_tasks[i].task);
+        if (handle == NULL) {
+            continue;
+        }
+        // Bytes on ESP-IDF, where StackType_t is a byte
+        uint32_t free_bytes = (uint32_t)uxTaskGetStackHighWaterMark(handle);
+        portENTER_CRITICAL(&s_lock);
+        if (s_tasks[i].samples == 0 || free_bytes < s_tasks[i].min_free) {
+            s_tasks[i].min_free = free_bytes;
+        }
+        s_tasks[i].samples++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static void sample_timer_cb(void *arg) {
+    (void)arg;
+    res_monitor_sample();
+}
+
+void res_monitor_start(void) {
+    if (s_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = sample_timer_cb,
+            .name = "res_monitor",
+        };
+        if (esp_timer_create(&args, &s_timer) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to create sampling timer");
+            return;
+        }
+    }
+    res_monitor_sample();
+#if RES_MONITOR_RUNTIME
+    s_run_start_count = uxTaskGetSystemState(s_run_start, RES_MONITOR_MAX_TASKS, &s_run_start_total);
+    s_run_end_count = 0;
+#endif
+    if (!esp_timer_is_active(s_timer)) {
+        esp_timer_start_periodic(s_timer, RES_MONITOR_PERIOD_MS * 1000ULL);
+    }
+}
+
+void res_monitor_stop(void) {
+    if (s_timer != NULL) {
+        esp_timer_stop(s_timer);
+    }
+#if RES_MONITOR_RUNTIME
+    // Before teardown deletes httpd and the NimBLE host, or their share is lost
+    s_run_end_count = uxTaskGetSystemState(s_run_end, RES_MONITOR_MAX_TASKS, &s_run_end_total);
+#endif
+}
+
+bool res_monitor_get_task(size_t index, res_monitor_task_t *task) {
+    if (index >= TASK_COUNT) {
+        return false;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *task = s_tasks[index];
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+uint32_t res_monitor_suggest_stack(const res_monitor_task_t *task) {
+    if (task->samples == 0 || task->min_free > task->stack_size) {
+        return 0;
+    }
+    uint32_t used = task->stack_size - task->min_free;
+    uint32_t size = used + RES_MONITOR_STACK_MARGIN;
+    return (size + RES_MONITOR_STACK_ALIGN - 1) / RES_MONITOR_STACK_ALIGN * RES_MONITOR_STACK_ALIGN;
+}
+
+void res_monitor_get_heap(res_monitor_heap_t *heap) {
+    multi_heap_info_t info;
+
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    heap->free_bytes = info.total_free_bytes;
+    heap->min_free_bytes = info.minimum_free_bytes;
+    heap->largest_block = info.largest_free_block;
+    heap->free_blocks = info.free_blocks;
+    heap->fragmentation_pct = info.total_free_bytes == 0 ? 0 :
+        (uint8_t)(100 - (uint64_t)info.largest_free_block * 100 / info.total_free_bytes);
+}
+
+void res_monitor_log_report(void) {
+    res_monitor_task_t task;
+    res_monitor_heap_t heap;
+
+    for (size_t i = 0; res_monitor_get_task(i, &task); i++) {
+        if (task.samples == 0) {
+            ESP_LOGI(TAG, "%-11s stack %u, not seen", task.task, (unsigned)task.stack_size);
+            continue;
+        }
+        ESP_LOGI(TAG, "%-11s stack %u, peak use %u, suggested %u (%u samples)", task.task,
+                 (unsigned)task.stack_size, (unsigned)(task.stack_size - task.min_free),
+                 (unsigned)res_monitor_suggest_stack(&task), (unsigned)task.samples);
+    }
+    res_monitor_get_heap(&heap);
+    ESP_LOGI(TAG, "Heap: free %u, min free %u, largest block %u, %u free blocks, %u%% fragmented",
+             (unsigned)heap.free_bytes, (unsigned)heap.min_free_bytes, (unsigned)heap.largest_block,
+             (unsigned)heap.free_blocks, heap.fragmentation_pct);
+#if RES_MONITOR_RUNTIME
+    log_runtime_report();
+#else
+    ESP_LOGI(TAG, "Build with sdkconfig.profiling for a per-task CPU share report");
+#endif
+}
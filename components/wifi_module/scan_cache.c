@@ -0,0 +1,159 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "scan_cache.h"
+#include "dlog.h"
+
+static const char *TAG = "SCAN_CACHE";
+
+static wifi_ap_record_t s_records[SCAN_CACHE_MAX_AP];
+static scan_cache_entry_t s_building[SCAN_CACHE_MAX_ENTRIES];   // only touched on the event loop
+static scan_cache_entry_t s_entries[SCAN_CACHE_MAX_ENTRIES];
+static int s_entry_count = 0;
+static int64_t s_updated_us = 0;
+static int64_t s_started_us = 0;
+static volatile bool s_scanning = false;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t scan_cache_start(bool force) {
+    int64_t now_us = esp_timer_get_time();
+    int64_t prev_started_us;
+    esp_err_t err = ESP_OK;
+
+    // httpd (/scan) and the event loop both start scans: check and claim the flag in one step
+    portENTER_CRITICAL(&s_lock);
+    if (s_scanning) {
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_OK;
+    }
+    prev_started_us = s_started_us;
+    if (!force && s_started_us != 0 && now_us - s_started_us < (int64_t)SCAN_CACHE_MIN_INTERVAL_MS * 1000) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        s_scanning = true;
+        s_started_us = now_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Short active dwell keeps the SoftAP's channel from being left for long while the portal is up
+    wifi_scan_config_t config = {
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active.min = 50,
+        .scan_time.active.max = 120,
+    };
+    err = esp_wifi_scan_start(&config, false);
+    if (err != ESP_OK) {
+        // A scan that never started doesn't count against the rate limit
+        portENTER_CRITICAL(&s_lock);
+        s_scanning = false;
+        s_started_us = prev_started_us;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGW(TAG, "Scan not started: %s", esp_err_to_name(err));
+        return err;
+    }
+    return ESP_OK;
+}
+
+void scan_cache_on_scan_done(void) {
+    uint16_t ap_count = SCAN_CACHE_MAX_AP;
+    scan_cache_entry_t *fresh = s_building;
+    int count = 0;
+
+    s_scanning = false;
+    if (esp_wifi_scan_get_ap_records(&ap_count, s_records) != ESP_OK) {
+        return;
+    }
+
+    // Deduplicate by SSID keeping the strongest BSSID, insertion-sorted by RSSI
+    for (int i = 0; i < ap_count; i++) {
+        const wifi_ap_record_t *rec = &s_records[i];
+        if (rec->ssid[0] == '\0') {
+            continue;
+        }
+
+        int pos = -1;
+        for (int j = 0; j < count; j++) {
+            if (strcmp(fresh[j].ssid, (const char *)rec->ssid) == 0) {
+                pos = j;
+                break;
+            }
+        }
+        if (pos >= 0) {
+            if (fresh[pos].rssi >= rec->rssi) {
+                continue;
+            }
+            memmove(&fresh[pos], &fresh[pos + 1], (count - pos - 1) * sizeof(fresh[0]));
+            count--;
+        }
+
+        int at = count;
+        while (at > 0 && fresh[at - 1].rssi < rec->rssi) {
+            at--;
+        }
+        if (at >= SCAN_CACHE_MAX_ENTRIES) {
+            continue;
+        }
+        if (count == SCAN_CACHE_MAX_ENTRIES) {
+            count--;
+        }
+        memmove(&fresh[at + 1], &fresh[at], (count - at) * sizeof(fresh[0]));
+        count++;
+
+        scan_cache_entry_t *e = &fresh[at];
+        memset(e, 0, sizeof(*e));
+        strncpy(e->ssid, (const char *)rec->ssid, sizeof(e->ssid) - 1);
+        memcpy(e->bssid, rec->bssid, sizeof(e->bssid));
+        e->rssi = rec->rssi;
+        e->channel = rec->primary;
+        e->authmode = (uint8_t)rec->authmode;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(s_entries, fresh, count * sizeof(fresh[0]));
+    s_entry_count = count;
+    s_updated_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+
+    dlog(DLOG_SCAN_DONE, ap_count, count, 0, 0);
+}
+
+bool scan_cache_get(int index, scan_cache_entry_t *entry) {
+    bool ok = false;
+
+    portENTER_CRITICAL(&s_lock);
+    if (index >= 0 && index < s_entry_count) {
+        *entry = s_entries[index];
+        ok = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ok;
+}
+
+int32_t scan_cache_age_ms(void) {
+    if (s_updated_us == 0) {
+        return -1;
+    }
+    return (int32_t)((esp_timer_get_time() - s_updated_us) / 1000);
+}
+
+bool scan_cache_is_fresh(void) {
+    int32_t age = scan_cache_age_ms();
+    return age >= 0 && age < SCAN_CACHE_MAX_AGE_MS;
+}
+
+bool scan_cache_is_scanning(void) {
+    return s_scanning;
+}
+
+void scan_cache_stop(void) {
+    if (s_scanning) {
+        esp_wifi_scan_stop();
+        s_scanning = false;
+    }
+}
@@ -1,51 +1,143 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
+#include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_system.h"
 #include "utilities.h"
-
-#define MAX_COMPONENTS 5
+#include "res_monitor.h"
 
 static const char* TAG = "UTILITIES";
-static stop_action_cb_t stop_callbacks[MAX_COMPONENTS];
+
+typedef struct {
+    const char *name;
+    stop_action_cb_t cb;
+} stop_component_t;
+
+static stop_component_t stop_callbacks[STOP_COMPONENTS_MAX];
 static int callback_count = 0;
+// Created on first use and reused, so repeated provisioning sessions don't churn the heap
 static TimerHandle_t global_prov_timer = NULL;
+static volatile bool teardown_running = false;
+
+#if PROV_STATIC_ALLOC
+static StaticTimer_t prov_timer_storage;
+static StaticTask_t teardown_task_storage;
+static StackType_t teardown_task_stack[TEARDOWN_TASK_STACK_SIZE];
+static TaskHandle_t teardown_task_handle = NULL;
+#endif
+
+static void run_stop_step(const char *name, stop_action_cb_t cb) {
+    uint32_t free_before = esp_get_free_heap_size();
+    uint32_t min_before = esp_get_minimum_free_heap_size();
+
+    // Last look at the stacks of whatever this step is about to delete
+    res_monitor_sample();
+    cb();
+    // Deleted tasks' stacks are only returned once the idle task has run
+    vTaskDelay(pdMS_TO_TICKS(TEARDOWN_SETTLE_MS));
+
+    uint32_t free_after = esp_get_free_heap_size();
+    ESP_LOGI(TAG, "Teardown %s: free heap %u -> %u (%+d), min free %u -> %u", name,
+             (unsigned)free_before, (unsigned)free_after, (int)(free_after - free_before),
+             (unsigned)min_before, (unsigned)esp_get_minimum_free_heap_size());
+}
+
+static void run_teardown(void) {
+    uint32_t free_start = esp_get_free_heap_size();
+
+    // From here on this task samples; the periodic sampler must not race the deletions
+    res_monitor_stop();
 
-static void global_timer_callback(TimerHandle_t xTimer) {
-    ESP_LOGW(TAG, "Provisioning period expired, Shutting down all advertisemnets");
     for (int i = 0; i < callback_count; i++) {
-        if (stop_callbacks[i] != NULL) {
-            stop_callbacks[i]();
+        if (stop_callbacks[i].cb != NULL) {
+            run_stop_step(stop_callbacks[i].name, stop_callbacks[i].cb);
         }
     }
+    ESP_LOGI(TAG, "Provisioning teardown reclaimed %d bytes", (int)(esp_get_free_heap_size() - free_start));
+    res_monitor_log_report();
 }
 
-void register_stop_component(stop_action_cb_t cb) {
-    if (callback_count < MAX_COMPONENTS) {
-        stop_callbacks[callback_count++] = cb;
-    }   
+static void teardown_task(void *param) {
+    (void)param;
+#if PROV_STATIC_ALLOC
+    // Parked between runs: a static task's TCB can't be reused safely until the idle task has reaped it
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        run_teardown();
+        teardown_running = false;
+    }
+#else
+    run_teardown();
+    teardown_running = false;
+    vTaskDelete(NULL);
+#endif
 }
 
-void start_provisioning_manager(int timeout_min) {
-    if (global_prov_timer != NULL) {
-        xTimerStop(global_prov_timer, 0);
-        xTimerDelete(global_prov_timer, 0);
-        global_prov_timer = NULL;
+void shutdown_provisioning_components(void) {
+    if (teardown_running) {
+        return;
+    }
+    teardown_running = true;
+    // httpd_stop and the NimBLE deinit block and need more stack than the timer or event tasks have
+#if PROV_STATIC_ALLOC
+    if (teardown_task_handle == NULL) {
+        teardown_task_handle = xTaskCreateStaticPinnedToCore(teardown_task, "prov_teardown", TEARDOWN_TASK_STACK_SIZE,
+                                                             NULL, TEARDOWN_TASK_PRIORITY, teardown_task_stack,
+                                                             &teardown_task_storage, TEARDOWN_TASK_CORE);
     }
+    xTaskNotifyGive(teardown_task_handle);
+#else
+    if (xTaskCreatePinnedToCore(teardown_task, "prov_teardown", TEARDOWN_TASK_STACK_SIZE, NULL, TEARDOWN_TASK_PRIORITY,
+                                NULL, TEARDOWN_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create teardown task");
+        teardown_running = false;
+    }
+#endif
+}
+
+static void global_timer_callback(TimerHandle_t xTimer) {
+    (void)xTimer;
+    ESP_LOGW(TAG, "Provisioning period expired, Shutting down all advertisemnets");
+    shutdown_provisioning_components();
+}
+
+esp_err_t register_stop_component(const char *name, stop_action_cb_t cb) {
+    if (callback_count >= STOP_COMPONENTS_MAX) {
+        ESP_LOGE(TAG, "Cannot register %s: all %d stop slots taken, raise STOP_COMPONENTS_MAX", name, STOP_COMPONENTS_MAX);
+        return ESP_ERR_NO_MEM;
+    }
+    stop_callbacks[callback_count].name = name;
+    stop_callbacks[callback_count].cb = cb;
+    callback_count++;
+    return ESP_OK;
+}
+
+void start_provisioning_manager(int timeout_min) {
+    TickType_t period = pdMS_TO_TICKS(timeout_min * 60000);
 
-    global_prov_timer = xTimerCreate("ProvTimer", pdMS_TO_TICKS(timeout_min * 60000), pdFALSE, NULL, global_timer_callback);
     if (global_prov_timer == NULL) {
-        ESP_LOGE(TAG, "Failed to create provisioning timer");
-    } else {
-        xTimerStart(global_prov_timer, 0);
+#if PROV_STATIC_ALLOC
+        global_prov_timer = xTimerCreateStatic("ProvTimer", period, pdFALSE, NULL, global_timer_callback, &prov_timer_storage);
+#else
+        global_prov_timer = xTimerCreate("ProvTimer", period, pdFALSE, NULL, global_timer_callback);
+#endif
+        if (global_prov_timer == NULL) {
+            ESP_LOGE(TAG, "Failed to create provisioning timer");
+            return;
+        }
+    }
+
+    // Restarts the countdown from now, whether or not it was already running
+    if (xTimerChangePeriod(global_prov_timer, period, 0) == pdPASS) {
         ESP_LOGI(TAG, "Provisioning timer started for %d minutes", timeout_min);
+    } else {
+        ESP_LOGE(TAG, "Failed to start provisioning timer");
     }
 }
 
 void stop_provisioning_manager(void) {
-    if (global_prov_timer != NULL) {
+    if (global_prov_timer != NULL && xTimerIsTimerActive(global_prov_timer)) {
         xTimerStop(global_prov_timer, 0);
-        xTimerDelete(global_prov_timer, 0);
-        global_prov_timer = NULL;
         ESP_LOGI(TAG, "Provisioning timer stopped");
     }
 }
@@ -1,111 +1,733 @@
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "web_server.h"
 #include "wifi_module.h"
 #include "utilities.h"
-#include <ctype.h>
+#include "prov_worker.h"
+#include "form_parser.h"
+#include "scan_cache.h"
+#include "boot_trace.h"
+#include "dlog.h"
+#include "res_monitor.h"
+#include "conn_check.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <string.h>
 
 #include <esp_http_server.h>
 
 
 static const char *TAG = "WEB_SERVER";
+static httpd_handle_t s_server = NULL;
 
-/* Simple HTML Form */
-const char* html_page = "<html><body>"
-                        "<h1>ESP32 WiFi Config</h1>"
-                        "<form action='/save' method='GET'>"
-                        "SSID: <input type='text' name='ssid'><br>"
-                        "Pass: <input type='text' name='pass'><br>"
-                        "<input type='submit' value='Save'>"
-                        "</form></body></html>";
-
-/* Handler for the root page (192.168.4.1) */
-esp_err_t get_handler(httpd_req_t *req) {
-    httpd_resp_send(req, html_page, HTTPD_RESP_USE_STRLEN);
+typedef esp_err_t (*async_fn_t)(httpd_req_t *req);
+
+// A request taken off the httpd task, with the handler that finishes it
+typedef struct {
+    httpd_req_t *req;       // NULL tells a worker to stop
+    async_fn_t fn;
+} async_job_t;
+
+#if WEB_ASYNC_WORKERS > 0
+static QueueHandle_t s_async_queue = NULL;
+static StaticQueue_t s_async_queue_storage;
+static uint8_t s_async_queue_buffer[WEB_ASYNC_QUEUE_LEN * sizeof(async_job_t)];
+static TaskHandle_t s_async_tasks[WEB_ASYNC_WORKERS];
+static volatile bool s_async_running[WEB_ASYNC_WORKERS];
+#if PROV_STATIC_ALLOC
+static StaticTask_t s_async_task_storage[WEB_ASYNC_WORKERS];
+static StackType_t s_async_task_stacks[WEB_ASYNC_WORKERS][WEB_ASYNC_STACK_SIZE];
+#endif
+#endif
+static uint32_t s_rejected = 0;
+
+/* Portal assets: gzip-compressed at build time and embedded in flash (see CMakeLists.txt) */
+extern const uint8_t index_html_gz_start[]  asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]    asm("_binary_index_html_gz_end");
+extern const uint8_t status_html_gz_start[] asm("_binary_status_html_gz_start");
+extern const uint8_t status_html_gz_end[]   asm("_binary_status_html_gz_end");
+extern const uint8_t style_css_gz_start[]   asm("_binary_style_css_gz_start");
+extern const uint8_t style_css_gz_end[]     asm("_binary_style_css_gz_end");
+extern const uint8_t app_js_gz_start[]      asm("_binary_app_js_gz_start");
+extern const uint8_t app_js_gz_end[]        asm("_binary_app_js_gz_end");
+
+typedef struct {
+    const char *uri;
+    const char *content_type;
+    const char *cache_control;
+    const uint8_t *start;
+    const uint8_t *end;
+    char etag[12];          // "crc32 of the compressed bytes", filled in at server start
+} portal_asset_t;
+
+enum { ASSET_INDEX, ASSET_STATUS, ASSET_STYLE, ASSET_APP };
+
+// HTML is revalidated on every load (cheap 304); CSS/JS are cached by the phone
+static portal_asset_t s_assets[] = {
+    [ASSET_INDEX]  = { "/",           "text/html",              "no-cache",             index_html_gz_start,  index_html_gz_end },
+    [ASSET_STATUS] = { "/status.html", "text/html",             "no-cache",             status_html_gz_start, status_html_gz_end },
+    [ASSET_STYLE]  = { "/style.css",  "text/css",               "public, max-age=86400", style_css_gz_start,  style_css_gz_end },
+    [ASSET_APP]    = { "/app.js",     "application/javascript", "public, max-age=86400", app_js_gz_start,     app_js_gz_end },
+};
+
+static void init_asset_etags(void) {
+    size_t total_gz = 0, total_raw = 0;
+
+    for (size_t i = 0; i < sizeof(s_assets) / sizeof(s_assets[0]); i++) {
+        portal_asset_t *asset = &s_assets[i];
+        size_t len = asset->end - asset->start;
+        snprintf(asset->etag, sizeof(asset->etag), "\"%08" PRIx32 "\"", esp_rom_crc32_le(0, asset->start, len));
+
+        // The gzip trailer ends with the uncompressed size (ISIZE, little endian)
+        const uint8_t *isize = asset->end - 4;
+        total_raw += isize[0] | (isize[1] << 8) | (isize[2] << 16) | ((uint32_t)isize[3] << 24);
+        total_gz += len;
+    }
+    ESP_LOGI(TAG, "Portal assets: %u bytes in flash (gzip), %u bytes uncompressed",
+             (unsigned)total_gz, (unsigned)total_raw);
+}
+
+/* Sends an asset from flash in chunks, or 304 if the client's copy is current */
+static esp_err_t send_asset(httpd_req_t *req, const portal_asset_t *asset) {
+    char inm[sizeof(asset->etag)];
+    int64_t start_us = esp_timer_get_time();
+
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+        strcmp(inm, asset->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", asset->etag);
+        httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset->content_type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+
+    // Chunks point straight into the flash mapping; nothing is copied to RAM first
+    const uint8_t *pos = asset->start;
+    while (pos < asset->end) {
+        size_t n = asset->end - pos;
+        if (n > PORTAL_CHUNK_SIZE) {
+            n = PORTAL_CHUNK_SIZE;
+        }
+        if (httpd_resp_send_chunk(req, (const char *)pos, n) != ESP_OK) {
+            httpd_resp_send_chunk(req, NULL, 0);
+            return ESP_FAIL;
+        }
+        pos += n;
+    }
+    esp_err_t err = httpd_resp_send_chunk(req, NULL, 0);
+    ESP_LOGD(TAG, "%s: %u bytes in %lld us", asset->uri, (unsigned)(asset->end - asset->start),
+             esp_timer_get_time() - start_us);
+    return err;
+}
+
+static esp_err_t send_overloaded(httpd_req_t *req) {
+    s_rejected++;
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+#if WEB_ASYNC_WORKERS > 0
+static void run_async_jobs(void) {
+    async_job_t job;
+
+    while (xQueueReceive(s_async_queue, &job, portMAX_DELAY) == pdTRUE && job.req != NULL) {
+        job.fn(job.req);
+        httpd_req_async_handler_complete(job.req);
+    }
+}
+
+static void async_worker_task(void *param) {
+    int index = (int)(intptr_t)param;
+
+#if PROV_STATIC_ALLOC
+    // Parked across server restarts: a static task's TCB can't be reused safely until the idle task has reaped it
+    while (1) {
+        run_async_jobs();
+        s_async_running[index] = false;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+#else
+    run_async_jobs();
+    s_async_running[index] = false;
+    s_async_tasks[index] = NULL;
+    vTaskDelete(NULL);
+#endif
+}
+
+static void start_async_workers(void) {
+    if (s_async_queue == NULL) {
+        s_async_queue = xQueueCreateStatic(WEB_ASYNC_QUEUE_LEN, sizeof(async_job_t), s_async_queue_buffer,
+                                           &s_async_queue_storage);
+    }
+    for (int i = 0; i < WEB_ASYNC_WORKERS; i++) {
+        if (s_async_running[i]) {
+            continue;
+        }
+        s_async_running[i] = true;
+#if PROV_STATIC_ALLOC
+        if (s_async_tasks[i] != NULL) {
+            xTaskNotifyGive(s_async_tasks[i]);
+            continue;
+        }
+        s_async_tasks[i] = xTaskCreateStaticPinnedToCore(async_worker_task, "httpd_async", WEB_ASYNC_STACK_SIZE,
+                                                         (void *)(intptr_t)i, WEB_ASYNC_PRIORITY,
+                                                         s_async_task_stacks[i], &s_async_task_storage[i],
+                                                         WEB_ASYNC_CORE);
+        bool created = (s_async_tasks[i] != NULL);
+#else
+        bool created = (xTaskCreatePinnedToCore(async_worker_task, "httpd_async", WEB_ASYNC_STACK_SIZE,
+                                                (void *)(intptr_t)i, WEB_ASYNC_PRIORITY, &s_async_tasks[i],
+                                                WEB_ASYNC_CORE) == pdPASS);
+#endif
+        if (!created) {
+            ESP_LOGW(TAG, "Async worker %d not started", i);
+            s_async_running[i] = false;
+            s_async_tasks[i] = NULL;
+        }
+    }
+}
+
+// Runs before httpd_stop(): a worker may still be sending on a request's socket
+static void stop_async_workers(void) {
+    const async_job_t stop = { .req = NULL };
+
+    for (int i = 0; i < WEB_ASYNC_WORKERS; i++) {
+        if (s_async_running[i]) {
+            xQueueSend(s_async_queue, &stop, portMAX_DELAY);
+        }
+    }
+    // Each finishes the request in hand first, which the send timeout bounds
+    for (int i = 0; i < WEB_ASYNC_WORKERS; i++) {
+        while (s_async_running[i]) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    // Requests that arrived behind the stop markers are released unanswered; the server is going away
+    async_job_t job;
+    while (xQueueReceive(s_async_queue, &job, 0) == pdTRUE) {
+        if (job.req != NULL) {
+            httpd_req_async_handler_complete(job.req);
+        }
+    }
+}
+#endif
+
+/* Finishes req with fn on an async worker, or answers 503 when they are all backed up */
+static esp_err_t run_async(httpd_req_t *req, async_fn_t fn) {
+#if WEB_ASYNC_WORKERS > 0
+    async_job_t job = { .fn = fn };
+
+    if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+        return fn(req);
+    }
+    if (xQueueSend(s_async_queue, &job, 0) != pdTRUE) {
+        httpd_req_async_handler_complete(job.req);
+        return send_overloaded(req);
+    }
     return ESP_OK;
+#else
+    return fn(req);
+#endif
 }
 
-//Simple URL decoding function
-void url_decode(char *dst, const char *src) {
-    char a, b;
-    while (*src) {
-        if ((*src == '%') &&
-            ((a = src[1]) && (b = src[2])) &&
-            (isxdigit(a) && isxdigit(b))) {
-            if (a >= 'a') a -= '32';
-            if (a >= 'A') a -= ('A' - 10);
-            else a -= '0';
-            if (b >= 'a') b -= '32';
-            if (b >= 'A') b -= ('A' - 10);
-            else b -= '0';
-            *dst++ = (char)((a << 4) | b);
-            src += 3;
-        } else if (*src == '+') {
-            *dst++ = ' ';
-            src++;
-        } else {
-            *dst++ = *src++;
+static esp_err_t send_asset_from_ctx(httpd_req_t *req) {
+    return send_asset(req, (const portal_asset_t *)req->user_ctx);
+}
+
+static esp_err_t asset_handler(httpd_req_t *req) {
+    return run_async(req, send_asset_from_ctx);
+}
+
+#define FORM_READ_TIMEOUT (-2)
+
+/* Reads the form into buf: the URL query for GET, the urlencoded body for POST.
+ * Returns its length, FORM_READ_TIMEOUT if the client stopped sending, or -1. */
+static int read_form(httpd_req_t *req, char *buf, size_t buf_len) {
+    if (req->method == HTTP_GET) {
+        size_t len = httpd_req_get_url_query_len(req);
+        if (len == 0 || len >= buf_len || httpd_req_get_url_query_str(req, buf, buf_len) != ESP_OK) {
+            return -1;
+        }
+        return (int)len;
+    }
+
+    // Leave room for the parser's final terminator
+    if (req->content_len == 0 || req->content_len >= buf_len) {
+        return -1;
+    }
+    size_t received = 0;
+    int timeouts = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            // A client that never finishes its body would otherwise hold this task forever
+            if (++timeouts > FORM_RECV_MAX_TIMEOUTS) {
+                return FORM_READ_TIMEOUT;
+            }
+            continue;
+        }
+        if (ret <= 0) {
+            return -1;
+        }
+        received += ret;
+    }
+    return (int)received;
+}
+
+static esp_err_t handle_save(httpd_req_t *req) {
+    char buf[FORM_MAX_LEN + 1];
+    char *ssid = NULL, *pass = NULL;
+    size_t ssid_len = 0, pass_len = 0;
+
+    int len = read_form(req, buf, sizeof(buf));
+    if (len == FORM_READ_TIMEOUT) {
+        httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, NULL);
+        // Close the connection rather than read what's left of the body on it
+        return ESP_FAIL;
+    }
+    if (len < 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to parse data");
+        return ESP_OK;
+    }
+
+    // One pass over the form; keys and values are decoded in place inside buf
+    form_parser_t parser;
+    char *key, *value;
+    size_t key_len, value_len;
+    form_parser_init(&parser, buf, len);
+    while (form_parser_next(&parser, &key, &key_len, &value, &value_len)) {
+        if (strcmp(key, "ssid") == 0) {
+            ssid = value;
+            ssid_len = value_len;
+        } else if (strcmp(key, "pass") == 0) {
+            pass = value;
+            pass_len = value_len;
         }
     }
-    *dst = '\0';
+
+    if (ssid == NULL || pass == NULL || ssid_len == 0 || ssid_len > 32 || pass_len > 64 ||
+        strlen(ssid) != ssid_len || strlen(pass) != pass_len) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to parse data");
+        return ESP_OK;
+    }
+
+    dlog_str(DLOG_WEB_CREDS, ssid, pass_len, 0, 0, 0);
+
+    boot_trace_mark(TRACE_CREDS_RECEIVED, PROV_SOURCE_WEB);
+    // The worker saves and applies them; this httpd worker is free again right away
+    if (prov_worker_post_credentials(PROV_SOURCE_WEB, ssid, pass, NULL) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Busy, try again");
+        return ESP_OK;
+    }
+    return send_asset(req, &s_assets[ASSET_STATUS]);
 }
 
 /* Handler to save SSID and Password */
 esp_err_t save_handler(httpd_req_t *req) {
-    char buf[128];
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = handle_save(req);
+    dlog_time_callback(DLOG_CB_HTTPD, start_us);
+    return err;
+}
 
-    char raw_ssid[32], raw_pass[64];
-    char decoded_ssid[32], decoded_pass[64];
+// Append s to buf as JSON string content; returns the new length or -1 if it does not fit
+static int json_append_escaped(char *buf, int len, int cap, const char *s) {
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        int n;
+        if (c == '"' || c == '\\') {
+            n = snprintf(buf + len, cap - len, "\\%c", c);
+        } else if (c < 0x20) {
+            n = snprintf(buf + len, cap - len, "\\u%04x", c);
+        } else {
+            n = snprintf(buf + len, cap - len, "%c", c);
+        }
+        if (n < 0 || n >= cap - len) {
+            return -1;
+        }
+        len += n;
+    }
+    return len;
+}
 
-    // Get the query string from the URL
-    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
-        ESP_LOGI(TAG, "Query received: %s", buf);
-        
-        // Parse the ssid and password from the query string
-        if (httpd_query_key_value(buf, "ssid", raw_ssid, sizeof(raw_ssid)) == ESP_OK &&
-            httpd_query_key_value(buf, "pass", raw_pass, sizeof(raw_pass)) == ESP_OK) {
-            
-            // Decode them!
-            url_decode(decoded_ssid, raw_ssid);
-            url_decode(decoded_pass, raw_pass);
-
-            ESP_LOGI(TAG, "Decoded SSID: %s, PASS: %s", decoded_ssid, decoded_pass);
-            
-            stop_provisioning_manager();
-            
-            // Save the DECODED versions of ssid and password
-            ESP_LOGI(TAG, "Saving credentials to NVS...");
-            save_wifi_credentials(decoded_ssid, decoded_pass);
-            httpd_resp_send(req, "<h1>Credentials Saved! ESP32 will now restart...</h1>", HTTPD_RESP_USE_STRLEN);
-            
-            // Wait a moment and then restart
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            esp_restart();
-            return ESP_OK;
-        }
-    }
-    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to parse data");
+/* Handler reporting the outcome of the last /save or BLE write */
+esp_err_t status_handler(httpd_req_t *req) {
+    static const char *state_names[] = { "idle", "connecting", "connected", "failed" };
+    prov_status_t status;
+    // Room for an SSID of control characters, each escaped as \u00XX
+    char resp[96 + 6 * sizeof(status.ssid)];
+
+    prov_worker_get_status(&status);
+    int len = snprintf(resp, sizeof(resp), "{\"state\":\"%s\",\"ssid\":\"", state_names[status.state]);
+    len = json_append_escaped(resp, len, sizeof(resp), status.ssid);
+    if (len < 0) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    snprintf(resp + len, sizeof(resp) - len, "\",\"ip\":\"" IPSTR "\",\"reason\":\"%s\"}",
+             IP2STR(&status.ip), status.state == PROV_STATE_FAILED ? wifi_module_reason_str(status.reason) : "");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
 
+/* Handler listing nearby networks from the scan cache.
+ * Never waits for the radio: a stale table kicks off a rate-limited background
+ * scan and the current contents are returned with "scanning":true. */
+esp_err_t scan_handler(httpd_req_t *req) {
+    scan_cache_entry_t ap;
+    char buf[SCAN_JSON_CHUNK];
+    int len;
+
+    if (!scan_cache_is_fresh()) {
+        scan_cache_start(false);
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    len = snprintf(buf, sizeof(buf), "{\"age_ms\":%" PRId32 ",\"scanning\":%s,\"aps\":[",
+                   scan_cache_age_ms(), scan_cache_is_scanning() ? "true" : "false");
+
+    for (int i = 0; scan_cache_get(i, &ap); i++) {
+        // Worst case per entry is every SSID byte escaped as \u00XX
+        if ((int)sizeof(buf) - len < (int)sizeof(ap.ssid) * 6 + 64) {
+            if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        len += snprintf(buf + len, sizeof(buf) - len, "%s{\"ssid\":\"", i > 0 ? "," : "");
+        len = json_append_escaped(buf, len, sizeof(buf), ap.ssid);
+        if (len < 0) {
+            return httpd_resp_send_chunk(req, NULL, 0);
+        }
+        len += snprintf(buf + len, sizeof(buf) - len, "\",\"rssi\":%d,\"ch\":%u,\"auth\":%u}",
+                        ap.rssi, ap.channel, ap.authmode);
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "]}");
+
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Connectivity checks of the common OSes; anything but their expected reply makes them open the portal
+static const char *s_probe_uris[] = {
+    "/generate_204",            // Android, ChromeOS
+    "/gen_204",
+    "/hotspot-detect.html",     // iOS, macOS
+    "/library/test/success.html",
+    "/connecttest.txt",         // Windows
+    "/ncsi.txt",
+    "/canonical.html",          // Firefox
+};
+
+/* Handler for captive-portal probes: redirect to the portal instead of the reply the OS expects */
+static esp_err_t captive_probe_handler(httpd_req_t *req) {
+    httpd_resp_set_status(req, "302 Found");
+    httpd_resp_set_hdr(req, "Location", PORTAL_URL);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* Handler reporting stack high-water marks of the tasks involved in provisioning, with the
+ * smallest stack each could run in, plus heap fragmentation. The portal is torn down before
+ * the last samples are taken, so the final figures are logged by res_monitor_log_report(). */
+esp_err_t resources_handler(httpd_req_t *req) {
+    res_monitor_task_t task;
+    res_monitor_heap_t heap;
+    char buf[DEBUG_JSON_CHUNK];
+    int len;
+
+    // Runs on the httpd task, which teardown stops before any other tracked task
+    res_monitor_sample();
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    len = snprintf(buf, sizeof(buf), "{\"tasks\":[");
+
+    for (size_t i = 0; res_monitor_get_task(i, &task); i++) {
+        if ((int)sizeof(buf) - len < 128) {
+            if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        len += snprintf(buf + len, sizeof(buf) - len,
+                        "%s{\"name\":\"%s\",\"stack\":%" PRIu32 ",\"samples\":%" PRIu32,
+                        i > 0 ? "," : "", task.task, task.stack_size, task.samples);
+        if (task.samples > 0) {
+            len += snprintf(buf + len, sizeof(buf) - len, ",\"min_free\":%" PRIu32 ",\"suggested\":%" PRIu32 "}",
+                            task.min_free, res_monitor_suggest_stack(&task));
+        } else {
+            len += snprintf(buf + len, sizeof(buf) - len, "}");
+        }
+    }
+
+    res_monitor_get_heap(&heap);
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "],\"heap\":{\"free\":%" PRIu32 ",\"min_free\":%" PRIu32 ",\"largest_block\":%" PRIu32
+                    ",\"free_blocks\":%" PRIu32 ",\"fragmentation_pct\":%u}}",
+                    heap.free_bytes, heap.min_free_bytes, heap.largest_block, heap.free_blocks,
+                    heap.fragmentation_pct);
+
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// One Prometheus series per stage reached so far: first-reached time or reach count
+static esp_err_t send_stage_series(httpd_req_t *req, char *buf, size_t cap, bool totals) {
+    int len;
+
+    if (totals) {
+        len = snprintf(buf, cap, "# HELP prov_stage_total Times the stage was reached since boot.\n"
+                                 "# TYPE prov_stage_total counter\n");
+    } else {
+        len = snprintf(buf, cap, "# HELP prov_stage_first_seconds Time since boot when the stage was first reached.\n"
+                                 "# TYPE prov_stage_first_seconds gauge\n");
+    }
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        int64_t first_us;
+        uint32_t count;
+        boot_trace_get_stage(stage, &first_us, &count);
+        if (count == 0) {
+            continue;
+        }
+        if ((int)cap - len < 96) {
+            if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        if (totals) {
+            len += snprintf(buf + len, cap - len, "prov_stage_total{stage=\"%s\"} %" PRIu32 "\n",
+                            boot_trace_stage_name(stage), count);
+        } else {
+            len += snprintf(buf + len, cap - len, "prov_stage_first_seconds{stage=\"%s\"} %lld.%06lld\n",
+                            boot_trace_stage_name(stage), first_us / 1000000, first_us % 1000000);
+        }
+    }
+    return httpd_resp_send_chunk(req, buf, len);
+}
+
+/* Log drops plus run time of the callbacks that log through dlog */
+static esp_err_t send_callback_series(httpd_req_t *req, char *buf, size_t buf_len) {
+    dlog_cb_stats_t stats;
+    int len = snprintf(buf, buf_len,
+                       "# HELP prov_log_dropped_total Deferred log messages lost to a full ring.\n"
+                       "# TYPE prov_log_dropped_total counter\n"
+                       "prov_log_dropped_total %" PRIu32 "\n"
+                       "# HELP prov_callback_seconds Time spent inside event, GATT and httpd callbacks.\n"
+                       "# TYPE prov_callback_seconds summary\n",
+                       dlog_get_dropped());
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    for (int cb = 0; cb < DLOG_CB_COUNT; cb++) {
+        dlog_get_callback_stats(cb, &stats);
+        const char *name = dlog_callback_name(cb);
+        len = snprintf(buf, buf_len,
+                       "prov_callback_seconds_sum{cb=\"%s\"} %" PRIu64 ".%06" PRIu64 "\n"
+                       "prov_callback_seconds_count{cb=\"%s\"} %" PRIu32 "\n",
+                       name, stats.total_us / 1000000, stats.total_us % 1000000,
+                       name, stats.count);
+        if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+
+    len = snprintf(buf, buf_len,
+                   "# HELP prov_callback_max_seconds Longest single callback run since boot.\n"
+                   "# TYPE prov_callback_max_seconds gauge\n");
+    for (int cb = 0; cb < DLOG_CB_COUNT && len < (int)buf_len; cb++) {
+        dlog_get_callback_stats(cb, &stats);
+        len += snprintf(buf + len, buf_len - len, "prov_callback_max_seconds{cb=\"%s\"} %" PRIu32 ".%06" PRIu32 "\n",
+                        dlog_callback_name(cb), stats.max_us / 1000000, stats.max_us % 1000000);
+    }
+    return httpd_resp_send_chunk(req, buf, len);
+}
+
+// One conn_check latency histogram, cumulative as Prometheus expects. Flushed a few lines at a time
+// so the buffer only needs room for one line past PROBE_LINE_MAX
+#define PROBE_LINE_MAX 128
+static esp_err_t send_probe_histogram(httpd_req_t *req, char *buf, size_t buf_len, const char *name,
+                                      const char *help, const uint32_t *hist, uint32_t sum_ms) {
+    static const uint32_t bounds[CONN_CHECK_HIST_BUCKETS] = CONN_CHECK_HIST_BOUNDS_MS;
+    uint32_t total = 0;
+    int len = snprintf(buf, buf_len, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+    for (int i = 0; i < CONN_CHECK_HIST_BUCKETS; i++) {
+        if ((int)buf_len - len < PROBE_LINE_MAX) {
+            if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        total += hist[i];
+        if (bounds[i] == UINT32_MAX) {
+            len += snprintf(buf + len, buf_len - len, "%s_bucket{le=\"+Inf\"} %" PRIu32 "\n", name, total);
+        } else {
+            len += snprintf(buf + len, buf_len - len, "%s_bucket{le=\"%" PRIu32 ".%03" PRIu32 "\"} %" PRIu32 "\n",
+                            name, bounds[i] / 1000, bounds[i] % 1000, total);
+        }
+    }
+    if ((int)buf_len - len < PROBE_LINE_MAX) {
+        if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        len = 0;
+    }
+    len += snprintf(buf + len, buf_len - len, "%s_sum %" PRIu32 ".%03" PRIu32 "\n%s_count %" PRIu32 "\n",
+                    name, sum_ms / 1000, sum_ms % 1000, name, total);
+    return httpd_resp_send_chunk(req, buf, len);
+}
+
+static esp_err_t send_probe_series(httpd_req_t *req, char *buf, size_t buf_len) {
+    conn_check_histograms_t hist;
+    conn_check_get_histograms(&hist);
+
+    if (send_probe_histogram(req, buf, buf_len, "prov_probe_dns_seconds",
+                             "Connectivity probe DNS lookup time.", hist.dns, hist.dns_sum_ms) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return send_probe_histogram(req, buf, buf_len, "prov_probe_connect_seconds",
+                                "Connectivity probe TCP connect time, for lookups that resolved.",
+                                hist.tcp, hist.tcp_sum_ms);
+}
+
+// Reconnect scheduler counters (wifi_module_get_reconnect_stats)
+static esp_err_t send_reconnect_series(httpd_req_t *req, char *buf, size_t buf_len) {
+    wifi_reconnect_stats_t stats;
+    wifi_module_get_reconnect_stats(&stats);
+
+    int len = snprintf(buf, buf_len,
+                       "# HELP prov_reconnect_rounds_total Scheduled reconnect rounds started.\n"
+                       "# TYPE prov_reconnect_rounds_total counter\n"
+                       "prov_reconnect_rounds_total %" PRIu32 "\n"
+                       "# HELP prov_reconnect_failed_rounds_total Rounds in which no known network could be joined.\n"
+                       "# TYPE prov_reconnect_failed_rounds_total counter\n"
+                       "prov_reconnect_failed_rounds_total %" PRIu32 "\n"
+                       "# HELP prov_reconnect_successes_total Times an IP was obtained.\n"
+                       "# TYPE prov_reconnect_successes_total counter\n"
+                       "prov_reconnect_successes_total %" PRIu32 "\n",
+                       stats.attempts, stats.failed_rounds, stats.successes);
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    len = snprintf(buf, buf_len,
+                   "# HELP prov_reconnect_retry_count Consecutive failed rounds since the last success.\n"
+                   "# TYPE prov_reconnect_retry_count gauge\n"
+                   "prov_reconnect_retry_count %" PRIu32 "\n"
+                   "# HELP prov_reconnect_backoff_seconds Delay before the pending retry, 0 when connected.\n"
+                   "# TYPE prov_reconnect_backoff_seconds gauge\n"
+                   "prov_reconnect_backoff_seconds %" PRIu32 ".%03" PRIu32 "\n",
+                   stats.retry_count, stats.current_backoff_ms / 1000, stats.current_backoff_ms % 1000);
+    return httpd_resp_send_chunk(req, buf, len);
+}
+
+static esp_err_t send_metrics(httpd_req_t *req) {
+    char buf[METRICS_CHUNK];
+    int len;
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    if (send_stage_series(req, buf, sizeof(buf), false) != ESP_OK ||
+        send_stage_series(req, buf, sizeof(buf), true) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    len = snprintf(buf, sizeof(buf),
+                   "# HELP prov_trace_events_total Trace entries stamped since boot.\n"
+                   "# TYPE prov_trace_events_total counter\n"
+                   "prov_trace_events_total %" PRIu32 "\n"
+                   "# HELP prov_heap_free_bytes Current free heap.\n"
+                   "# TYPE prov_heap_free_bytes gauge\n"
+                   "prov_heap_free_bytes %" PRIu32 "\n"
+                   "# HELP prov_heap_min_free_bytes Lowest free heap since boot.\n"
+                   "# TYPE prov_heap_min_free_bytes gauge\n"
+                   "prov_heap_min_free_bytes %" PRIu32 "\n"
+                   "# HELP prov_http_rejected_total Requests answered 503 because the async workers were backed up.\n"
+                   "# TYPE prov_http_rejected_total counter\n"
+                   "prov_http_rejected_total %" PRIu32 "\n",
+                   boot_trace_total(), esp_get_free_heap_size(), esp_get_minimum_free_heap_size(), s_rejected);
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK ||
+        send_callback_series(req, buf, sizeof(buf)) != ESP_OK ||
+        send_reconnect_series(req, buf, sizeof(buf)) != ESP_OK ||
+        send_probe_series(req, buf, sizeof(buf)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/* Handler exposing the boot trace, heap, reconnect counters and probe latencies as Prometheus text */
+esp_err_t metrics_handler(httpd_req_t *req) {
+    return run_async(req, send_metrics);
+}
+
 /* Function to start the server */
 void start_webserver(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    int sockets = ESP_MAX_STA_CONN * WEB_SOCKETS_PER_CLIENT;
+
+    if (sockets > CONFIG_LWIP_MAX_SOCKETS - WEB_SOCKETS_RESERVED) {
+        sockets = CONFIG_LWIP_MAX_SOCKETS - WEB_SOCKETS_RESERVED;
+    }
+    _Static_assert(WEB_ASYNC_WORKERS + WEB_ASYNC_QUEUE_LEN < CONFIG_LWIP_MAX_SOCKETS - WEB_SOCKETS_RESERVED,
+                   "async requests would hold every socket; raise CONFIG_LWIP_MAX_SOCKETS");
     
     // Increase these values to handle modern mobile browsers
     config.max_resp_headers = 20;
-    config.stack_size = 8192; // Give the server more breathing room
+    config.stack_size = WEB_SERVER_STACK_SIZE;
+    config.task_priority = WEB_SERVER_PRIORITY;
+    config.core_id = WEB_SERVER_CORE;
     config.lru_purge_enable = true; // Clean up old connections automatically
+    config.max_uri_handlers = WEB_MAX_URI_HANDLERS;
+    config.max_open_sockets = sockets;
+    config.keep_alive_enable = true;
+    config.keep_alive_idle = WEB_KEEPALIVE_IDLE_S;
+    config.keep_alive_interval = WEB_KEEPALIVE_INTERVAL_S;
+    config.keep_alive_count = WEB_KEEPALIVE_COUNT;
+    config.recv_wait_timeout = WEB_RECV_TIMEOUT_S;
+    config.send_wait_timeout = WEB_SEND_TIMEOUT_S;
+
+    if (s_server != NULL) {
+        return;
+    }
 
     httpd_handle_t server = NULL;
 
     if (httpd_start(&server, &config) == ESP_OK) {
-        httpd_uri_t uri_get = {
-            .uri      = "/",
-            .method   = HTTP_GET,
-            .handler  = get_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &uri_get);
+        s_server = server;
+        init_asset_etags();
+#if WEB_ASYNC_WORKERS > 0
+        start_async_workers();
+#endif
+        for (size_t i = 0; i < sizeof(s_assets) / sizeof(s_assets[0]); i++) {
+            httpd_uri_t uri_asset = {
+                .uri      = s_assets[i].uri,
+                .method   = HTTP_GET,
+                .handler  = asset_handler,
+                .user_ctx = &s_assets[i]
+            };
+            httpd_register_uri_handler(server, &uri_asset);
+        }
 
         httpd_uri_t uri_save = {
             .uri      = "/save",
@@ -114,7 +736,65 @@ void start_webserver(void) {
             .user_ctx = NULL
         };
         httpd_register_uri_handler(server, &uri_save);
+        uri_save.method = HTTP_POST;
+        httpd_register_uri_handler(server, &uri_save);
+
+        httpd_uri_t uri_status = {
+            .uri      = "/status",
+            .method   = HTTP_GET,
+            .handler  = status_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &uri_status);
+
+        httpd_uri_t uri_scan = {
+            .uri      = "/scan",
+            .method   = HTTP_GET,
+            .handler  = scan_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &uri_scan);
+
+        httpd_uri_t uri_metrics = {
+            .uri      = "/metrics",
+            .method   = HTTP_GET,
+            .handler  = metrics_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &uri_metrics);
+
+        httpd_uri_t uri_resources = {
+            .uri      = "/debug/resources",
+            .method   = HTTP_GET,
+            .handler  = resources_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &uri_resources);
+
+        for (size_t i = 0; i < sizeof(s_probe_uris) / sizeof(s_probe_uris[0]); i++) {
+            httpd_uri_t uri_probe = {
+                .uri      = s_probe_uris[i],
+                .method   = HTTP_GET,
+                .handler  = captive_probe_handler,
+                .user_ctx = NULL
+            };
+            httpd_register_uri_handler(server, &uri_probe);
+        }
+
+        boot_trace_mark(TRACE_HTTPD_STARTED, 0);
         
-        ESP_LOGI(TAG, "Server started with increased limits.");
+        ESP_LOGI(TAG, "Server started: %d sockets for %d clients, %d async workers",
+                 sockets, ESP_MAX_STA_CONN, WEB_ASYNC_WORKERS);
+    }
+}
+
+void stop_webserver(void) {
+    if (s_server != NULL) {
+#if WEB_ASYNC_WORKERS > 0
+        stop_async_workers();
+#endif
+        httpd_stop(s_server);
+        s_server = NULL;
+        ESP_LOGI(TAG, "Server stopped.");
     }
 }
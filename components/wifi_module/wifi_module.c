@@ -1,119 +1,676 @@
 #include "freertos/FreeRTOS.h" // Always include this before other FreeRTOS headers
 #include "freertos/timers.h"
+#include "freertos/event_groups.h"
 #include "wifi_module.h"
 #include "ble_provisioning.h"
 #include "web_server.h"
 #include "utilities.h"
+#include "prov_worker.h"
+#include "conn_check.h"
+#include "scan_cache.h"
+#include "boot_trace.h"
+#include "dlog.h"
+#include "res_monitor.h"
+#include "captive_dns.h"
+#include "wifi_storage.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "nvs_flash.h"
-#include "lwip/dns.h"
-#include "lwip/netdb.h"
 #include "nvs.h"
+#if WIFI_PROV_QEMU_ETH
+#include "esp_eth.h"
+#if !CONFIG_ETH_USE_OPENETH
+#error "WIFI_PROV_QEMU_ETH needs CONFIG_ETH_USE_OPENETH (build with sdkconfig.qemu)"
+#endif
+#endif
 #include <ctype.h>
+#include <string.h>
 
 static const char *TAG = "WIFI_CONN";
-static bool ble_provisioning_started = false;
 static bool stop_component_registered = false;
+static bool s_portal_active = false;
+static bool s_portal_timed_out = false;     // don't reopen the portal until a connection succeeds again
+static esp_netif_t *s_ap_netif = NULL;
+static esp_netif_t *s_sta_netif = NULL;
 
-static void stop_softap_and_server(void);
+// Live apply of freshly provisioned credentials: the transport waits on these bits
+#define APPLY_CONNECTED_BIT  BIT0
+#define APPLY_FAILED_BIT     BIT1
+#define APPLY_STARTED_BIT    BIT2
+static EventGroupHandle_t s_apply_events = NULL;
+// Owned by the event loop; the transport's task only reads the results after a bit is set
+static bool s_applying = false;
+static bool s_apply_connect_issued = false;
+static uint8_t s_apply_reason = 0;
+static esp_err_t s_apply_err = ESP_OK;
+static esp_ip4_addr_t s_apply_ip;
 
-// store SSID and PASSWORDS to NVS
+// Payload of WIFI_MODULE_EVENT_APPLY
+typedef struct {
+    char ssid[33];
+    wifi_secret_t secret;
+    uint8_t bssid[6];
+    bool has_bssid;
+} apply_request_t;
+
+ESP_EVENT_DEFINE_BASE(WIFI_MODULE_EVENT);
+
+// Reconnect scheduler: failed rounds are retried from a one-shot timer with jittered exponential backoff
+static esp_timer_handle_t s_reconnect_timer = NULL;
+// Written on the event loop, read from httpd (/metrics)
+static wifi_reconnect_stats_t s_reconnect_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// A remembered network seen in the last scan, in the order we'll try them
+typedef struct {
+    wifi_cred_entry_t *entry;
+    int8_t rssi;
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_candidate_t;
+
+// Remembered networks, each with its fast-connect hint (last AP BSSID/channel/authmode)
+static wifi_cred_table_t s_creds;
+static wifi_cred_entry_t *s_current = NULL;
+static wifi_candidate_t s_candidates[WIFI_MAX_SAVED_NETWORKS];
+static int s_candidate_count = 0;
+static int s_candidate_pos = 0;
+static bool s_scanning = false;
+static int s_retry_num = 0;
+
+static bool s_fast_connect_active = false;
+static bool s_used_fast_connect = false;
+static int64_t s_connect_start_us = 0;
+
+static void post_portal_closed(void);
+
+#if WIFI_STORE_PSK
+// WPA2 PSK = PBKDF2-HMAC-SHA1(passphrase, ssid, 4096, 32). Done once here so boots don't pay for it.
+static esp_err_t derive_wifi_psk(const char* ssid, const char* password, uint8_t psk[WIFI_PSK_LEN]) {
+    int64_t start_us = esp_timer_get_time();
+    int rc = wifi_psk_derive(ssid, password, psk);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "PSK derivation failed: %d", rc);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "PSK derived in %lld ms (saved on every reconnect)", (esp_timer_get_time() - start_us) / 1000);
+    return ESP_OK;
+}
+#endif
+
+esp_err_t wifi_module_prepare_secret(const char* ssid, const char* password, wifi_secret_t *secret) {
+    size_t pass_len = strlen(password);
+
+    memset(secret, 0, sizeof(*secret));
+    if (pass_len > sizeof(secret->secret)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#if WIFI_STORE_PSK
+    // Open networks and passwords that already are a 64-hex-digit PSK are stored as given
+    if (pass_len >= 8 && pass_len < 64 && derive_wifi_psk(ssid, password, secret->secret) == ESP_OK) {
+        secret->len = WIFI_PSK_LEN;
+        secret->is_psk = true;
+        return ESP_OK;
+    }
+#endif
+    memcpy(secret->secret, password, pass_len);
+    secret->len = pass_len;
+    return ESP_OK;
+}
+
+// Add to / update the remembered-network table in NVS; cheap enough for the event loop
+static esp_err_t store_credentials(const char* ssid, const wifi_secret_t *secret) {
+    if (strlen(ssid) >= sizeof(s_creds.entries[0].ssid) || secret->len > sizeof(s_creds.entries[0].secret)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wifi_cred_entry_t *entry = wifi_storage_add(&s_creds, ssid);
+    // A freshly provisioned network counts as the most recent one, so it is preferred on equal signal
+    wifi_storage_mark_success(&s_creds, entry);
+    memcpy(entry->secret, secret->secret, secret->len);
+    entry->secret_len = secret->len;
+    if (secret->is_psk) {
+        entry->flags |= WIFI_CRED_F_PSK;
+    }
+
+    // No fast-connect hint until we've actually joined it
+    esp_err_t err = wifi_storage_save(&s_creds);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "WiFi credentials saved to NVS (%d networks remembered)", s_creds.count);
+    }
+    return err;
+}
+
+// store SSID and PASSWORDS to NVS (adds to / updates the remembered-network table)
 esp_err_t save_wifi_credentials(const char* ssid, const char* password) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+    wifi_secret_t secret;
 
-    //Open NVS storage in R/W mode
-    err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        return err;
+    esp_err_t err = wifi_module_prepare_secret(ssid, password, &secret);
+    if (err == ESP_OK) {
+        err = store_credentials(ssid, &secret);
     }
+    memset(&secret, 0, sizeof(secret));
+    return err;
+}
 
-    //Write SSID and Password
-    err = nvs_set_str(nvs_handle, "wifi_ssid", ssid);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
+// Last registered stop step, on the teardown task: the portal state belongs to the event loop
+static void post_portal_closed(void) {
+    esp_event_post(WIFI_MODULE_EVENT, WIFI_MODULE_EVENT_PORTAL_CLOSED, NULL, 0, portMAX_DELAY);
+}
+
+// The web server, DNS and BLE have already been stopped by their own teardown steps
+static void close_softap(void) {
+    wifi_ap_record_t ap_info;
+
+    s_portal_active = false;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        // Provisioned: only the AP half of the radio goes
+        esp_wifi_set_mode(WIFI_MODE_STA);
+    } else if (s_creds.count > 0) {
+        // Saved networks may come back (router outage): drop the AP, keep the reconnect scheduler going
+        ESP_LOGW("WIFI_MOD", "SoftAP timeout reached. Closing config mode, still retrying saved networks");
+        s_portal_timed_out = true;
+        esp_wifi_set_mode(WIFI_MODE_STA);
+    } else {
+        ESP_LOGW("WIFI_MOD", "SoftAP timeout reached. Shutting down config mode...");
+        if (s_reconnect_timer != NULL) {
+            esp_timer_stop(s_reconnect_timer);
+            esp_timer_delete(s_reconnect_timer);
+            s_reconnect_timer = NULL;
+        }
+        esp_wifi_set_mode(WIFI_MODE_NULL); 
+        esp_wifi_stop();
+        ESP_LOGI("WIFI_MOD", "Radio disabled to save power.");
+    }
+
+    if (s_ap_netif != NULL) {
+        esp_netif_destroy_default_wifi(s_ap_netif);
+        s_ap_netif = NULL;
+    }
+}
+
+// Only touch flash when the AP or the preferred network actually changed
+static void save_connection_info(void) {
+    wifi_ap_record_t ap_info;
+    wifi_cred_entry_t *entry = s_current;
+
+    if (entry == NULL || esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return;
+    }
+
+    bool same_ap = (entry->flags & WIFI_CRED_F_FAST_VALID) &&
+                   memcmp(entry->bssid, ap_info.bssid, sizeof(entry->bssid)) == 0 &&
+                   entry->channel == ap_info.primary && entry->authmode == (uint8_t)ap_info.authmode;
+    bool most_recent = (entry->last_success == s_creds.success_seq);
+    if (same_ap && most_recent) {
+        return;
+    }
+
+    memcpy(entry->bssid, ap_info.bssid, sizeof(entry->bssid));
+    entry->channel = ap_info.primary;
+    entry->authmode = (uint8_t)ap_info.authmode;
+    entry->flags |= WIFI_CRED_F_FAST_VALID;
+    if (!most_recent) {
+        wifi_storage_mark_success(&s_creds, entry);
+    }
+
+    if (wifi_storage_save(&s_creds) == ESP_OK) {
+        dlog_str(DLOG_WIFI_FAST_HINT, entry->ssid, entry->channel, entry->authmode, 0, 0);
+    }
+}
+
+static void fill_sta_config(const wifi_cred_entry_t *entry, wifi_config_t *wifi_config) {
+    memset(wifi_config, 0, sizeof(*wifi_config));
+    memcpy(wifi_config->sta.ssid, entry->ssid, strlen(entry->ssid));
+    if (entry->flags & WIFI_CRED_F_PSK) {
+        // The driver treats a 64-hex-digit password as a raw PSK and skips PBKDF2
+        static const char hex[] = "0123456789abcdef";
+        for (int i = 0; i < WIFI_PSK_LEN; i++) {
+            wifi_config->sta.password[i * 2] = hex[entry->secret[i] >> 4];
+            wifi_config->sta.password[i * 2 + 1] = hex[entry->secret[i] & 0x0f];
+        }
+    } else {
+        memcpy(wifi_config->sta.password, entry->secret, entry->secret_len);
+    }
+}
+
+// Directed connect: we already know where the AP is, so the driver doesn't have to scan
+static void connect_directed(wifi_cred_entry_t *entry, const uint8_t *bssid, uint8_t channel) {
+    wifi_config_t wifi_config;
+
+    fill_sta_config(entry, &wifi_config);
+    memcpy(wifi_config.sta.bssid, bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.bssid_set = true;
+    wifi_config.sta.channel = channel;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+
+    s_current = entry;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_connect();
+}
+
+static void connection_round_failed(void);
+
+// One scan serves every remembered network
+static void start_network_scan(void) {
+    s_fast_connect_active = false;
+    s_candidate_count = 0;
+    s_candidate_pos = 0;
+    boot_trace_mark(TRACE_SCAN_START, 0);
+    // Shared with the portal's /scan: if it already has a scan running we just wait for that one
+    if (scan_cache_start(true) == ESP_OK) {
+        s_scanning = true;
+    } else {
+        // No SCAN_DONE will follow, so nothing would schedule the next round
+        ESP_LOGE(TAG, "Failed to start scan");
+        connection_round_failed();
+    }
+}
+
+static bool candidate_before(const wifi_candidate_t *a, const wifi_candidate_t *b) {
+    return wifi_policy_rank_before(a->rssi, a->entry->last_success, b->rssi, b->entry->last_success);
+}
+
+static void rank_scan_results(void) {
+    scan_cache_entry_t ap;
+
+    s_candidate_count = 0;
+    s_candidate_pos = 0;
+
+    // The scan cache is already deduplicated by SSID, keeping the strongest BSSID
+    for (int i = 0; scan_cache_get(i, &ap); i++) {
+        wifi_cred_entry_t *entry = wifi_storage_find(&s_creds, ap.ssid);
+        if (entry == NULL || s_candidate_count >= WIFI_MAX_SAVED_NETWORKS) {
+            continue;
+        }
+        wifi_candidate_t *c = &s_candidates[s_candidate_count++];
+        c->entry = entry;
+        c->rssi = ap.rssi;
+        c->channel = ap.channel;
+        memcpy(c->bssid, ap.bssid, sizeof(c->bssid));
+    }
+
+    // Insertion sort; the table holds at most WIFI_MAX_SAVED_NETWORKS entries
+    for (int i = 1; i < s_candidate_count; i++) {
+        wifi_candidate_t tmp = s_candidates[i];
+        int j = i - 1;
+        while (j >= 0 && candidate_before(&tmp, &s_candidates[j])) {
+            s_candidates[j + 1] = s_candidates[j];
+            j--;
+        }
+        s_candidates[j + 1] = tmp;
+    }
+
+    for (int i = 0; i < s_candidate_count; i++) {
+        dlog_str(DLOG_WIFI_CANDIDATE, s_candidates[i].entry->ssid, s_candidates[i].rssi, s_candidates[i].channel, 0, 0);
+    }
+}
+
+static void try_current_candidate(void) {
+    wifi_candidate_t *c = &s_candidates[s_candidate_pos];
+    dlog_str(DLOG_WIFI_CONNECTING, c->entry->ssid, 0, 0, 0, 0);
+    connect_directed(c->entry, c->bssid, c->channel);
+}
+
+static void reconnect_timer_callback(void *arg) {
+    // Hop onto the event loop so all connection state stays on one task
+    esp_event_post(WIFI_MODULE_EVENT, WIFI_MODULE_EVENT_RECONNECT, NULL, 0, 0);
+}
+
+static void schedule_reconnect(void) {
+    if (s_reconnect_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = reconnect_timer_callback,
+            .name = "wifi_reconnect",
+        };
+        if (esp_timer_create(&args, &s_reconnect_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create reconnect timer");
+            return;
+        }
+    }
+
+    uint32_t delay_ms = wifi_policy_backoff_ms(s_retry_num, esp_random());
+    portENTER_CRITICAL(&s_stats_lock);
+    s_reconnect_stats.current_backoff_ms = delay_ms;
+    portEXIT_CRITICAL(&s_stats_lock);
+    esp_timer_stop(s_reconnect_timer);
+    esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000);
+    dlog(DLOG_WIFI_NEXT_RECONNECT, delay_ms, 0, 0, 0);
+}
+
+// Connected again while the portal was serving: it's no longer needed
+static void close_provisioning_portal(void) {
+    ESP_LOGI(TAG, "Connected to saved network, closing provisioning portal");
+    s_portal_active = false;
+    boot_trace_mark(TRACE_PORTAL_CLOSED, 0);
+    stop_provisioning_manager();
+    // Same steps as the timeout, so the portal's memory is reclaimed either way
+    shutdown_provisioning_components();
+}
+
+static void handle_scan_results(void) {
+    rank_scan_results();
+    if (s_candidate_count > 0) {
+        try_current_candidate();
+    } else {
+        connection_round_failed();
+    }
+}
+
+// Every candidate from the last scan failed
+static void connection_round_failed(void) {
+    if (s_creds.count == 0) {
+        return;
+    }
+
+    s_retry_num++;
+    portENTER_CRITICAL(&s_stats_lock);
+    s_reconnect_stats.failed_rounds++;
+    s_reconnect_stats.retry_count = s_retry_num;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    if (s_retry_num >= MAX_RETRY && !s_portal_active && !s_portal_timed_out) {
+        ESP_LOGW(TAG, "Connection failed. Starting SoftAP or BLE for reconfiguration...");
+        // APSTA mode: the scheduler keeps retrying the saved networks behind the portal
+        wifi_init_softap(); 
+    } else {
+        dlog(DLOG_WIFI_RETRY, s_retry_num, 0, 0, 0);
+    }
+    schedule_reconnect();
+}
+
+void wifi_module_get_reconnect_stats(wifi_reconnect_stats_t *stats) {
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_reconnect_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+esp_err_t wifi_module_apply_credentials(const char* ssid, const wifi_secret_t *secret, const uint8_t *bssid,
+                                       wifi_apply_result_t *result) {
+    apply_request_t req;
+
+    memset(result, 0, sizeof(*result));
+    if (strlen(ssid) >= sizeof(req.ssid)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&req, 0, sizeof(req));
+    strcpy(req.ssid, ssid);
+    req.secret = *secret;
+    if (bssid != NULL) {
+        memcpy(req.bssid, bssid, sizeof(req.bssid));
+        req.has_bssid = true;
     }
-    err = nvs_set_str(nvs_handle, "wifi_pass", password);
+
+    ble_provisioning_notify_status(BLE_PROV_STATUS_SAVING, 0, 0);
+    // The credential table and the scan state belong to the event loop; the save and connect happen there
+    xEventGroupClearBits(s_apply_events, APPLY_STARTED_BIT);
+    esp_err_t err = esp_event_post(WIFI_MODULE_EVENT, WIFI_MODULE_EVENT_APPLY, &req, sizeof(req), portMAX_DELAY);
+    memset(&req, 0, sizeof(req));
     if (err != ESP_OK) {
-        nvs_close(nvs_handle);
         return err;
     }
+    // Set once the loop has cleared the previous result, so a stale bit can't answer this request
+    xEventGroupWaitBits(s_apply_events, APPLY_STARTED_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
 
-    //commit the chnages to flash
-    err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
+    EventBits_t bits = xEventGroupWaitBits(s_apply_events, APPLY_CONNECTED_BIT | APPLY_FAILED_BIT,
+                                           pdTRUE, pdFALSE, pdMS_TO_TICKS(WIFI_APPLY_TIMEOUT_MS));
+    if (bits & APPLY_CONNECTED_BIT) {
+        result->ip = s_apply_ip;
+        return ESP_OK;
+    }
+    if (bits & APPLY_FAILED_BIT) {
+        result->disconnect_reason = s_apply_reason;
+        return s_apply_err;
+    }
 
-    ESP_LOGI(TAG, "WiFi credentials saved to NVS");
-    return err;
+    // Keep trying the remembered networks (including the new one) behind the portal
+    esp_event_post(WIFI_MODULE_EVENT, WIFI_MODULE_EVENT_APPLY_TIMEOUT, NULL, 0, portMAX_DELAY);
+    ESP_LOGW(TAG, "No connection within %d ms, continuing in the background", WIFI_APPLY_TIMEOUT_MS);
+    ble_provisioning_notify_status(BLE_PROV_STATUS_FAILED, 0, 0);
+    return ESP_ERR_TIMEOUT;
 }
 
-static void stop_softap_and_server(void) {
-    ESP_LOGW("WIFI_MOD", "SoftAP timeout reached. Shutting down config mode...");
-    
-    // 1. Stop the Web Server
-    // We'll need to store the server handle globally to stop it properly
-    // For simplicity here, we stop all instances
-    
-    // 2. Turn off the AP part of the radio
-    stop_ble_provisioning();
-    esp_wifi_set_mode(WIFI_MODE_NULL); 
-    esp_wifi_stop();
-    
-    ESP_LOGI("WIFI_MOD", "Radio disabled to save power.");
+static void finish_apply(EventBits_t bit) {
+    s_applying = false;
+    s_apply_connect_issued = false;
+    xEventGroupSetBits(s_apply_events, bit);
 }
 
-void stop_provisioning_timer(void) {
-    stop_provisioning_manager();
-    ESP_LOGI("WIFI_MODE", "Provisioning timer stopped.");
+// Event loop side of wifi_module_apply_credentials(): save, park the scheduler and load the new config
+static void start_apply(apply_request_t *req) {
+    wifi_config_t wifi_config;
+    wifi_cred_entry_t *entry = NULL;
+
+    xEventGroupClearBits(s_apply_events, APPLY_CONNECTED_BIT | APPLY_FAILED_BIT);
+    s_apply_reason = 0;
+    s_apply_err = store_credentials(req->ssid, &req->secret);
+    if (s_apply_err == ESP_OK) {
+        entry = wifi_storage_find(&s_creds, req->ssid);
+        if (entry == NULL) {
+            s_apply_err = ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    if (s_apply_err == ESP_OK) {
+        // Park the background scheduler while the new network is tried
+        if (s_reconnect_timer != NULL) {
+            esp_timer_stop(s_reconnect_timer);
+        }
+        scan_cache_stop();
+        s_scanning = false;
+        s_fast_connect_active = false;
+        s_candidate_count = 0;
+        s_candidate_pos = 0;
+
+        s_applying = true;
+        s_apply_connect_issued = false;
+        esp_wifi_disconnect();
+
+        fill_sta_config(entry, &wifi_config);
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        if (req->has_bssid) {
+            memcpy(wifi_config.sta.bssid, req->bssid, sizeof(wifi_config.sta.bssid));
+            wifi_config.sta.bssid_set = true;
+        }
+        s_apply_err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    }
+    if (s_apply_err == ESP_OK) {
+        s_current = entry;
+        // Disconnects already queued belong to the attempt we just cut short; connect behind them
+        s_apply_err = esp_event_post(WIFI_MODULE_EVENT, WIFI_MODULE_EVENT_APPLY_CONNECT, NULL, 0, 0);
+    }
+    if (s_apply_err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not apply new credentials live: %s", esp_err_to_name(s_apply_err));
+        finish_apply(APPLY_FAILED_BIT);
+    } else {
+        ESP_LOGI(TAG, "Applying new credentials for %s without restart...", req->ssid);
+    }
+    memset(&req->secret, 0, sizeof(req->secret));
+    xEventGroupSetBits(s_apply_events, APPLY_STARTED_BIT);
+}
+
+void wifi_module_finish_provisioning(void) {
+    // Runs the teardown on the event loop, after the transport has answered its client
+    esp_event_post(WIFI_MODULE_EVENT, WIFI_MODULE_EVENT_PROVISIONED, NULL, 0, 0);
+}
+
+const char *wifi_module_reason_str(uint8_t reason) {
+    switch (reason) {
+    case WIFI_REASON_AUTH_FAIL:
+    case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_HANDSHAKE_TIMEOUT:
+        return "wrong password";
+    case WIFI_REASON_NO_AP_FOUND:
+        return "network not found";
+    case 0:
+        return "timed out";
+    default:
+        return "connection failed";
+    }
 }
 
 // Event handler to catch WiFi events
-static void event_handler(void* arg, esp_event_base_t event_base,
+static void handle_event(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data) {
-    static int s_retry_num = 0;
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
-    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < MAX_RETRY) {
+    if (event_base == WIFI_MODULE_EVENT && event_id == WIFI_MODULE_EVENT_APPLY) {
+        start_apply((apply_request_t *)event_data);
+    } else if (event_base == WIFI_MODULE_EVENT && event_id == WIFI_MODULE_EVENT_APPLY_CONNECT) {
+        // The apply may already have timed out
+        if (!s_applying) {
+            return;
+        }
+        s_connect_start_us = esp_timer_get_time();
+        s_apply_err = esp_wifi_connect();
+        if (s_apply_err != ESP_OK) {
+            ESP_LOGE(TAG, "Could not apply new credentials live: %s", esp_err_to_name(s_apply_err));
+            finish_apply(APPLY_FAILED_BIT);
+            return;
+        }
+        s_apply_connect_issued = true;
+        ble_provisioning_notify_status(BLE_PROV_STATUS_CONNECTING, 0, 0);
+    } else if (event_base == WIFI_MODULE_EVENT && event_id == WIFI_MODULE_EVENT_APPLY_TIMEOUT) {
+        if (s_applying) {
+            s_applying = false;
+            s_apply_connect_issued = false;
+            schedule_reconnect();
+        }
+    } else if (event_base == WIFI_MODULE_EVENT && event_id == WIFI_MODULE_EVENT_PORTAL_CLOSED) {
+        close_softap();
+    } else if (event_base == WIFI_MODULE_EVENT && event_id == WIFI_MODULE_EVENT_PROVISIONED) {
+        if (s_portal_active) {
+            close_provisioning_portal();
+        }
+    } else if (event_base == WIFI_MODULE_EVENT && event_id == WIFI_MODULE_EVENT_RECONNECT) {
+        if (s_creds.count > 0 && !s_applying) {
+            portENTER_CRITICAL(&s_stats_lock);
+            s_reconnect_stats.attempts++;
+            portEXIT_CRITICAL(&s_stats_lock);
+            // Results the portal fetched recently are as good as a new scan
+            if (scan_cache_is_fresh()) {
+                s_fast_connect_active = false;
+                handle_scan_results();
+            } else {
+                start_network_scan();
+            }
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        if (s_fast_connect_active) {
             esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Router not found. Retrying... (%d/%d)", s_retry_num, MAX_RETRY);
+        } else if (s_creds.count > 0) {
+            start_network_scan();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        scan_cache_on_scan_done();
+        if (!s_scanning) {
+            return;
+        }
+        s_scanning = false;
+        boot_trace_mark(TRACE_SCAN_DONE, 0);
+        handle_scan_results();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        boot_trace_mark(TRACE_STA_CONNECTED, 0);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        wifi_event_sta_disconnected_t *disconnected = (wifi_event_sta_disconnected_t *)event_data;
+        conn_check_invalidate();
+        if (s_applying) {
+            // Disconnects of the attempt the apply cut short, and our own esp_wifi_disconnect(), aren't a verdict
+            if (s_apply_connect_issued && disconnected->reason != WIFI_REASON_ASSOC_LEAVE) {
+                ESP_LOGW(TAG, "New credentials rejected: %s", wifi_module_reason_str(disconnected->reason));
+                s_apply_reason = disconnected->reason;
+                s_apply_err = ESP_FAIL;
+                finish_apply(APPLY_FAILED_BIT);
+                ble_provisioning_notify_status(BLE_PROV_STATUS_FAILED, disconnected->reason, 0);
+                // Keep trying the remembered networks (including the new one) behind the portal
+                schedule_reconnect();
+            }
+        } else if (s_fast_connect_active) {
+            // The cached AP is gone or moved; this attempt doesn't count against MAX_RETRY
+            dlog(DLOG_WIFI_FAST_FAIL, 0, 0, 0, 0);
+            start_network_scan();
+        } else if (s_candidate_pos + 1 < s_candidate_count) {
+            // Next-best known network from the same scan, no rescan needed
+            s_candidate_pos++;
+            try_current_candidate();
         } else {
-            ESP_LOGW(TAG, "Connection failed. Starting SoftAP or BLE for reconfiguration...");
-            // Switch to APSTA mode so we can still try to connect while the AP is active
-            wifi_init_softap(); 
-            s_retry_num = 0; // Reset counter so it doesn't loop infinitely
+            connection_round_failed();
         }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        ESP_LOGI(TAG, "WiFi connected!");
-
         if (event_id == IP_EVENT_STA_GOT_IP) {
             ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-            ESP_LOGI(TAG, "Success! Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
-
-            struct addrinfo hints = {
-                .ai_family = AF_INET,
-                .ai_socktype = SOCK_STREAM,
-            };
-            struct addrinfo* res;
-
-            int err = getaddrinfo("google.com", "80", &hints, &res);
-            if (err == 0) {
-                ESP_LOGI(TAG, "DNS Lookup Success! Internet is reachable!");
-                freeaddrinfo(res);
-            } else {
-                ESP_LOGE(TAG, "DNS Lookup Failed. Check your router's internet connection");
+            if (s_applying && !s_apply_connect_issued) {
+                // Late result of the connection the apply replaced
+                return;
+            }
+            dlog(DLOG_WIFI_GOT_IP, esp_ip4_addr1_16(&event->ip_info.ip), esp_ip4_addr2_16(&event->ip_info.ip),
+                 esp_ip4_addr3_16(&event->ip_info.ip), esp_ip4_addr4_16(&event->ip_info.ip));
+
+            int64_t now_us = esp_timer_get_time();
+            boot_trace_mark(TRACE_GOT_IP, (uint32_t)((now_us - s_connect_start_us) / 1000));
+            dlog_str(DLOG_WIFI_TIME_TO_IP,
+                     s_fast_connect_active ? "fast connect" : (s_used_fast_connect ? "fast connect fallback" : "scan"),
+                     (uint32_t)((now_us - s_connect_start_us) / 1000), (uint32_t)(now_us / 1000),
+                     esp_get_free_heap_size(), 0);
+            s_fast_connect_active = false;
+            s_portal_timed_out = false;
+            s_retry_num = 0;
+            portENTER_CRITICAL(&s_stats_lock);
+            s_reconnect_stats.retry_count = 0;
+            s_reconnect_stats.current_backoff_ms = 0;
+            s_reconnect_stats.successes++;
+            portEXIT_CRITICAL(&s_stats_lock);
+            if (s_reconnect_timer != NULL) {
+                esp_timer_stop(s_reconnect_timer);
             }
+            if (s_applying) {
+                // The transport reports the result first, then calls wifi_module_finish_provisioning()
+                s_apply_ip = event->ip_info.ip;
+                finish_apply(APPLY_CONNECTED_BIT);
+                ble_provisioning_notify_status(BLE_PROV_STATUS_CONNECTED, 0, event->ip_info.ip.addr);
+            } else if (s_portal_active) {
+                close_provisioning_portal();
+            }
+            // A later disconnect starts over with a fresh scan
+            s_candidate_count = 0;
+            s_candidate_pos = 0;
+            save_connection_info();
+
+            // DNS + TCP probe runs on its own task; the result arrives as a CONN_CHECK_EVENT
+            conn_check_trigger(false);
+        }
+    } else if (event_base == CONN_CHECK_EVENT) {
+        static bool s_trace_dumped = false;
+        const conn_check_result_t *result = (const conn_check_result_t *)event_data;
+        boot_trace_mark(TRACE_PROBE_DONE, result->online ? result->dns_ms + result->tcp_ms : 0);
+        // The first probe ends the boot timeline
+        if (!s_trace_dumped) {
+            s_trace_dumped = true;
+            boot_trace_dump_log();
         }
     }
 }
 
+static void event_handler(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data) {
+    int64_t start_us = esp_timer_get_time();
+    handle_event(arg, event_base, event_id, event_data);
+    dlog_time_callback(DLOG_CB_WIFI_EVENT, start_us);
+}
+
 void wifi_init_softap(void) {
     ESP_LOGI("WIFI_MODE", "Initializing SoftAP...");
-    esp_netif_create_default_wifi_ap();
+    // The portal can come up more than once per boot now that reconnects continue behind it
+    if (s_ap_netif == NULL) {
+        s_ap_netif = esp_netif_create_default_wifi_ap();
+    }
+    // New credentials are applied live on the STA side of APSTA
+    if (s_sta_netif == NULL) {
+        s_sta_netif = esp_netif_create_default_wifi_sta();
+    }
 
     wifi_config_t wifi_config = {
         .ap = {
@@ -134,16 +691,24 @@ void wifi_init_softap(void) {
     ESP_ERROR_CHECK(esp_wifi_start());
 
     ESP_LOGI("WIFI_MODE", "SoftAP Started. SSID: %s", ESP_WIFI_AP_SSID);
+    boot_trace_mark(TRACE_SOFTAP_STARTED, 0);
+    s_portal_active = true;
 
+    prov_worker_start();
     start_webserver();
-    if (!ble_provisioning_started) {
-        start_ble_provisioning();
-        ble_provisioning_started = true;
-        ESP_LOGI("WIFI_MODE", "BLE provisioning advertising started.");
+    // Every name resolves to the portal, so phones show it without the user typing an address
+    esp_netif_ip_info_t ap_ip;
+    if (esp_netif_get_ip_info(s_ap_netif, &ap_ip) == ESP_OK) {
+        captive_dns_start(ap_ip.ip.addr);
     }
+    start_ble_provisioning();
+    res_monitor_start();
 
     if (!stop_component_registered) {
-        register_stop_component(stop_softap_and_server);
+        ESP_ERROR_CHECK(register_stop_component("web server", stop_webserver));
+        ESP_ERROR_CHECK(register_stop_component("DNS", captive_dns_stop));
+        ESP_ERROR_CHECK(register_stop_component("BLE", stop_ble_provisioning));
+        ESP_ERROR_CHECK(register_stop_component("SoftAP", post_portal_closed));
         stop_component_registered = true;
     }
 
@@ -151,7 +716,36 @@ void wifi_init_softap(void) {
     start_provisioning_manager(1);
 }
 
+#if WIFI_PROV_QEMU_ETH
+// Espressif QEMU's open_eth NIC; the address comes from QEMU's user-mode network over DHCP
+static void qemu_eth_start(void) {
+    esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_ETH();
+    esp_netif_t *netif = esp_netif_new(&netif_cfg);
+
+    eth_mac_config_t mac_cfg = ETH_MAC_DEFAULT_CONFIG();
+    eth_phy_config_t phy_cfg = ETH_PHY_DEFAULT_CONFIG();
+    // The emulated PHY has no link to negotiate
+    phy_cfg.autonego_timeout_ms = 100;
+    esp_eth_mac_t *mac = esp_eth_mac_new_openeth(&mac_cfg);
+    esp_eth_phy_t *phy = esp_eth_phy_new_dp83848(&phy_cfg);
+    esp_eth_config_t eth_cfg = ETH_DEFAULT_CONFIG(mac, phy);
+    esp_eth_handle_t eth = NULL;
+    ESP_ERROR_CHECK(esp_eth_driver_install(&eth_cfg, &eth));
+    ESP_ERROR_CHECK(esp_netif_attach(netif, esp_eth_new_netif_glue(eth)));
+    ESP_ERROR_CHECK(esp_eth_start(eth));
+}
+#endif
+
+// Boot cost of each configuration; compare across builds with and without WIFI_LEAN_BOOT
+static void log_boot_report(const char *mode) {
+    ESP_LOGI(TAG, "Boot (%s): init done %lld ms after reset, free heap %u, min free %u, largest block %u",
+             mode, esp_timer_get_time() / 1000, (unsigned)esp_get_free_heap_size(),
+             (unsigned)esp_get_minimum_free_heap_size(), (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
 void wifi_module_init(void) {
+    boot_trace_mark(TRACE_INIT_START, 0);
+    dlog_init();
     // 1. Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -159,53 +753,93 @@ void wifi_module_init(void) {
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_trace_mark(TRACE_NVS_READY, 0);
     // 2. Initialize Network Interface
     ESP_ERROR_CHECK(esp_netif_init());
+    boot_trace_mark(TRACE_NETIF_READY, 0);
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+    boot_trace_mark(TRACE_EVENT_LOOP_READY, 0);
     // esp_netif_create_default_wifi_sta(); called below at line 107
 
+    s_apply_events = xEventGroupCreate();
+    // Probe target and timeouts from menuconfig ("WiFi module")
+    conn_check_init(NULL);
+
+#if WIFI_PROV_QEMU_ETH
+    qemu_eth_start();
+#else
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    boot_trace_mark(TRACE_WIFI_INIT_DONE, 0);
+#endif
 
     // 3. Register our event handler
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_MODULE_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(CONN_CHECK_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
 
-    //4. Check if we have saved credentials in NVS
-    nvs_handle_t handle;
-    char saved_ssid[32] = {0};
-    char saved_pass[64] = {0};
-    size_t ssid_len = sizeof(saved_ssid);
-    size_t pass_len = sizeof(saved_pass);
-
-    bool has_creds = false;
+#if WIFI_PROV_QEMU_ETH
+    // Always the portal, over Ethernet. /save still stores the credentials, but the live apply finds no
+    // radio and the worker falls back to a restart; time /save last.
+    ESP_LOGI(TAG, "QEMU build, serving the portal over openeth");
+    s_portal_active = true;
+    prov_worker_start();
+    start_webserver();
+    log_boot_report("provisioning, openeth");
+    return;
+#endif
 
-    if (nvs_open("storage", NVS_READONLY, &handle) == ESP_OK) {
-        if (nvs_get_str(handle, "wifi_ssid", saved_ssid, &ssid_len) == ESP_OK && 
-            nvs_get_str(handle, "wifi_pass", saved_pass, &pass_len) == ESP_OK) {
-            has_creds = true;
-            ESP_LOGI(TAG, "Found saved credentials in NVS");
-        }
-        nvs_close(handle);
+    //4. Check if we have saved credentials in NVS (one lookup; migrates the old wifi_ssid/wifi_pass keys)
+    bool has_creds = (wifi_storage_load(&s_creds) == ESP_OK);
+    if (!has_creds) {
+        memset(&s_creds, 0, sizeof(s_creds));
     }
 
     if (has_creds) {
         //PATH A:: CONNECT TO SAVED WIFI
-        ESP_LOGI("WIFI_MOD", "Credentials Found, Connecting to %s...", saved_ssid);
-        esp_netif_create_default_wifi_sta();
-        
-        wifi_config_t wifi_config = {0};
-        strncpy((char*)wifi_config.sta.ssid, saved_ssid, sizeof(wifi_config.sta.ssid));
-        strncpy((char*)wifi_config.sta.password, saved_pass, sizeof(wifi_config.sta.password));
+        ESP_LOGI("WIFI_MOD", "Credentials Found for %d network(s), Connecting...", s_creds.count);
+        s_sta_netif = esp_netif_create_default_wifi_sta();
+
+        // Most recently joined network
+        wifi_cred_entry_t *last = &s_creds.entries[0];
+        for (int i = 1; i < s_creds.count; i++) {
+            if (s_creds.entries[i].last_success > last->last_success) {
+                last = &s_creds.entries[i];
+            }
+        }
+
+        wifi_config_t wifi_config;
+        fill_sta_config(last, &wifi_config);
+        if ((last->flags & WIFI_CRED_F_FAST_VALID) && last->channel >= 1 && last->channel <= 14) {
+            // Directed single-channel connect to the AP we used last time, before any scan
+            memcpy(wifi_config.sta.bssid, last->bssid, sizeof(wifi_config.sta.bssid));
+            wifi_config.sta.bssid_set = true;
+            wifi_config.sta.channel = last->channel;
+            wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+            wifi_config.sta.threshold.authmode = (wifi_auth_mode_t)last->authmode;
+            s_current = last;
+            s_fast_connect_active = true;
+            s_used_fast_connect = true;
+            ESP_LOGI(TAG, "Fast-connect cache hit for %s, trying channel %d first", last->ssid, last->channel);
+        }
 
         ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
         ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+        s_connect_start_us = esp_timer_get_time();
         ESP_ERROR_CHECK(esp_wifi_start());
+        boot_trace_mark(TRACE_WIFI_STARTED, s_fast_connect_active);
         ESP_LOGI(TAG, "WiFi Started");
+#if WIFI_LEAN_BOOT
+        // Nothing has touched the controller yet; its reserved RAM is better spent as heap
+        ble_provisioning_release_memory();
+#endif
+        log_boot_report(WIFI_LEAN_BOOT ? "STA only, lean" : "STA only");
         return; 
     } else {
         //PATH B:: START SOFTAP FOR CONFIG
         ESP_LOGI("WIFI_MODE", "No Credentials Found, Starting SoftAP for configuration...");
         wifi_init_softap();
+        log_boot_report("provisioning");
     }
 }
@@ -0,0 +1,20 @@
+#include "wifi_policy.h"
+
+uint32_t wifi_policy_backoff_ms(int attempt, uint32_t random) {
+    int shift = attempt < 0 ? 0 : (attempt > 16 ? 16 : attempt);
+    uint64_t delay = (uint64_t)WIFI_BACKOFF_BASE_MS << shift;
+    if (delay > WIFI_BACKOFF_MAX_MS) {
+        delay = WIFI_BACKOFF_MAX_MS;
+    }
+    uint32_t half = (uint32_t)delay / 2;
+    return half + (half > 0 ? random % (half + 1) : 0);
+}
+
+bool wifi_policy_rank_before(int8_t rssi_a, uint32_t last_a, int8_t rssi_b, uint32_t last_b) {
+    int bucket_a = (rssi_a + 128) / WIFI_RSSI_BUCKET_DB;
+    int bucket_b = (rssi_b + 128) / WIFI_RSSI_BUCKET_DB;
+    if (bucket_a != bucket_b) {
+        return bucket_a > bucket_b;
+    }
+    return last_a > last_b;
+}
@@ -0,0 +1,11 @@
+#include <string.h>
+#include "mbedtls/md.h"
+#include "mbedtls/pkcs5.h"
+#include "wifi_psk.h"
+
+int wifi_psk_derive(const char *ssid, const char *passphrase, uint8_t psk[WIFI_PSK_LEN]) {
+    return mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1,
+                                         (const unsigned char *)passphrase, strlen(passphrase),
+                                         (const unsigned char *)ssid, strlen(ssid),
+                                         4096, WIFI_PSK_LEN, psk);
+}
@@ -0,0 +1,144 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "wifi_storage.h"
+
+static const char *TAG = "WIFI_STORAGE";
+static uint32_t s_write_count = 0;
+
+static uint32_t table_crc(const wifi_cred_table_t *table) {
+    return esp_rom_crc32_le(0, (const uint8_t *)table, offsetof(wifi_cred_table_t, crc32));
+}
+
+static esp_err_t write_table(nvs_handle_t handle, wifi_cred_table_t *table) {
+    table->magic = WIFI_CRED_RECORD_MAGIC;
+    table->version = WIFI_CRED_RECORD_VERSION;
+    table->crc32 = table_crc(table);
+
+    esp_err_t err = nvs_set_blob(handle, WIFI_CRED_NVS_KEY, table, sizeof(*table));
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_commit(handle);
+    if (err == ESP_OK) {
+        s_write_count++;
+        ESP_LOGI(TAG, "Credential table written (%u flash writes since boot)", (unsigned)s_write_count);
+    }
+    return err;
+}
+
+// Build a table from the wifi_ssid/wifi_pass keys of older firmware, store it and drop the keys in the same commit
+static esp_err_t migrate_legacy_keys(nvs_handle_t handle, wifi_cred_table_t *table) {
+    wifi_cred_entry_t *entry = &table->entries[0];
+    char pass[65] = {0};
+    size_t len = sizeof(entry->ssid);
+
+    memset(table, 0, sizeof(*table));
+    if (nvs_get_str(handle, "wifi_ssid", entry->ssid, &len) != ESP_OK) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    len = sizeof(pass);
+    if (nvs_get_str(handle, "wifi_pass", pass, &len) != ESP_OK) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    entry->secret_len = strlen(pass);
+    memcpy(entry->secret, pass, entry->secret_len);
+    entry->last_success = 1;
+    table->success_seq = 1;
+    table->count = 1;
+
+    nvs_erase_key(handle, "wifi_ssid");
+    nvs_erase_key(handle, "wifi_pass");
+
+    ESP_LOGI(TAG, "Migrating legacy credential keys to the multi-network table");
+    return write_table(handle, table);
+}
+
+esp_err_t wifi_storage_load(wifi_cred_table_t *table) {
+    nvs_handle_t handle;
+    size_t len = sizeof(*table);
+
+    esp_err_t err = nvs_open(WIFI_CRED_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_get_blob(handle, WIFI_CRED_NVS_KEY, table, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = migrate_legacy_keys(handle, table);
+        nvs_close(handle);
+        return err;
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (len != sizeof(*table) || table->magic != WIFI_CRED_RECORD_MAGIC ||
+        table->version != WIFI_CRED_RECORD_VERSION || table->crc32 != table_crc(table) ||
+        table->count > WIFI_MAX_SAVED_NETWORKS) {
+        ESP_LOGW(TAG, "Stored credential table is corrupt or from an unknown version");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // Never trust lengths from flash
+    for (int i = 0; i < table->count; i++) {
+        table->entries[i].ssid[sizeof(table->entries[i].ssid) - 1] = '\0';
+        if (table->entries[i].secret_len > sizeof(table->entries[i].secret)) {
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+    return table->count > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t wifi_storage_save(wifi_cred_table_t *table) {
+    nvs_handle_t handle;
+
+    esp_err_t err = nvs_open(WIFI_CRED_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = write_table(handle, table);
+    nvs_close(handle);
+    return err;
+}
+
+wifi_cred_entry_t *wifi_storage_find(wifi_cred_table_t *table, const char *ssid) {
+    for (int i = 0; i < table->count; i++) {
+        if (strncmp(table->entries[i].ssid, ssid, sizeof(table->entries[i].ssid)) == 0) {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+wifi_cred_entry_t *wifi_storage_add(wifi_cred_table_t *table, const char *ssid) {
+    wifi_cred_entry_t *entry = wifi_storage_find(table, ssid);
+
+    if (entry == NULL) {
+        if (table->count < WIFI_MAX_SAVED_NETWORKS) {
+            entry = &table->entries[table->count++];
+        } else {
+            entry = &table->entries[0];
+            for (int i = 1; i < table->count; i++) {
+                if (table->entries[i].last_success < entry->last_success) {
+                    entry = &table->entries[i];
+                }
+            }
+            ESP_LOGW(TAG, "Credential table full, forgetting %s", entry->ssid);
+        }
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->ssid, ssid, sizeof(entry->ssid) - 1);
+    return entry;
+}
+
+void wifi_storage_mark_success(wifi_cred_table_t *table, wifi_cred_entry_t *entry) {
+    entry->last_success = ++table->success_seq;
+}
+
+uint32_t wifi_storage_get_write_count(void) {
+    return s_write_count;
+}
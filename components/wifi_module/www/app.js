@@ -0,0 +1,17 @@
+// Polls /status after /save until the provisioning worker reports the outcome
+function poll() {
+  fetch('/status').then(function (r) { return r.json(); }).then(function (j) {
+    var s = document.getElementById('s');
+    var d = document.getElementById('d');
+    if (j.state === 'connected') {
+      s.textContent = 'Connected to ' + j.ssid + '!';
+      d.textContent = 'Device IP: ' + j.ip;
+    } else if (j.state === 'failed') {
+      s.textContent = 'Could not connect: ' + j.reason;
+      d.innerHTML = '<a href="/">Try again</a>';
+    } else {
+      setTimeout(poll, 1000);
+    }
+  }).catch(function () { setTimeout(poll, 1000); });
+}
+poll();
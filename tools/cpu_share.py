@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Per-task CPU share of provisioning sessions, as a Markdown table, from device logs.
+
+Built with sdkconfig.profiling laid over the project sdkconfig, the device logs each session's
+share of one core per task when the portal shuts down:
+
+    I (61234) RES_MONITOR: CPU share over 60012 ms of provisioning (% of one core):
+    I (61234) RES_MONITOR:   nimble_host      prio 21    3.2%
+    I (61234) RES_MONITOR:   httpd            prio  5    1.9%
+
+Pass any number of captured logs (one per session, or concatenated). Every task gets its priority
+and the mean and max share across sessions, busiest first.
+
+    idf.py -DSDKCONFIG_DEFAULTS="sdkconfig;sdkconfig.profiling" build flash monitor | tee session.txt
+    tools/cpu_share.py session.txt
+"""
+
+import argparse
+import re
+import sys
+
+HEADER = re.compile(r"RES_MONITOR: CPU share over (\d+) ms")
+ROW = re.compile(r"RES_MONITOR:   (.+?)\s+prio\s+(\d+)\s+([0-9.]+)%")
+
+
+def parse_sessions(paths):
+    sessions = []
+    current = None
+    for path in paths:
+        with open(path, errors="replace") as f:
+            for line in f:
+                m = HEADER.search(line)
+                if m:
+                    current = {}
+                    sessions.append((int(m.group(1)), current))
+                    continue
+                m = ROW.search(line)
+                if m and current is not None:
+                    current[m.group(1)] = (int(m.group(2)), float(m.group(3)))
+                else:
+                    current = None
+    return sessions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("logs", nargs="+", help="serial logs containing CPU share reports")
+    args = parser.parse_args()
+
+    sessions = parse_sessions(args.logs)
+    if not sessions:
+        sys.exit("no CPU share reports found; was the image built with sdkconfig.profiling?")
+
+    tasks = {}
+    for _, shares in sessions:
+        for name, (prio, share) in shares.items():
+            entry = tasks.setdefault(name, {"prio": prio, "shares": []})
+            entry["shares"].append(share)
+
+    total_ms = sum(window for window, _ in sessions)
+    print("%d session(s), %.1f s of provisioning\n" % (len(sessions), total_ms / 1000.0))
+    print("| task | prio | mean % | max % |")
+    print("|---|---:|---:|---:|")
+    # A task missing from a session used no CPU in it
+    rows = [(name, e["prio"], sum(e["shares"]) / len(sessions), max(e["shares"])) for name, e in tasks.items()]
+    for name, prio, mean, peak in sorted(rows, key=lambda r: -r[2]):
+        print("| %s | %d | %.1f | %.1f |" % (name, prio, mean, peak))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Fire bursts of DNS queries at the captive-portal responder and report how many were answered.
+
+Join the device's SoftAP, then run:
+
+    tools/dns_burst.py --bursts 20 --burst-size 50
+
+Each burst sends --burst-size A queries for random names back to back, then collects replies
+until --timeout passes. A reply counts as answered when its ID matches an outstanding query
+and it carries exactly one A record with the expected portal address.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import time
+
+from stats import percentile
+
+
+def build_query(qid, name):
+    header = struct.pack(">HHHHHH", qid, 0x0100, 1, 0, 0, 0)
+    qname = b"".join(bytes([len(label)]) + label.encode() for label in name.split(".")) + b"\0"
+    return header + qname + struct.pack(">HH", 1, 1)
+
+
+def parse_answer(packet):
+    """ID and the A record's address of a reply, or (id, None) if it has no single A record."""
+    if len(packet) < 12:
+        return None, None
+    qid, flags, qdcount, ancount = struct.unpack(">HHHH", packet[:8])
+    if not flags & 0x8000 or ancount != 1:
+        return qid, None
+    return qid, socket.inet_ntoa(packet[-4:])
+
+
+def run_burst(sock, size, timeout, expect):
+    pending = {}
+    for _ in range(size):
+        qid = random.getrandbits(16)
+        while qid in pending:
+            qid = random.getrandbits(16)
+        name = "probe%08x.example.com" % random.getrandbits(32)
+        pending[qid] = time.monotonic()
+        sock.send(build_query(qid, name))
+
+    answered, latencies = 0, []
+    deadline = time.monotonic() + timeout
+    while pending and time.monotonic() < deadline:
+        sock.settimeout(max(0.001, deadline - time.monotonic()))
+        try:
+            qid, addr = parse_answer(sock.recv(512))
+        except socket.timeout:
+            break
+        if qid in pending and addr == expect:
+            latencies.append((time.monotonic() - pending.pop(qid)) * 1000.0)
+            answered += 1
+    return answered, latencies
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.4.1", help="responder address")
+    parser.add_argument("--port", type=int, default=53)
+    parser.add_argument("--expect", default="192.168.4.1", help="address every answer should carry")
+    parser.add_argument("--bursts", type=int, default=10)
+    parser.add_argument("--burst-size", type=int, default=50)
+    parser.add_argument("--timeout", type=float, default=1.0, help="seconds to collect replies per burst")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((args.host, args.port))
+
+    sent = answered = 0
+    latencies = []
+    for i in range(args.bursts):
+        n, lat = run_burst(sock, args.burst_size, args.timeout, args.expect)
+        sent += args.burst_size
+        answered += n
+        latencies += lat
+        print("burst %3d: %4d/%d answered" % (i + 1, n, args.burst_size))
+
+    if sent == 0:
+        sys.exit("nothing sent")
+    print("total: %d/%d answered (%.1f%%)" % (answered, sent, 100.0 * answered / sent))
+    if latencies:
+        print("latency ms: p50 %.1f, p90 %.1f, max %.1f" % (
+            percentile(latencies, 50), percentile(latencies, 90), max(latencies)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Closed-loop HTTP load against the provisioning portal.
+
+Join the device's SoftAP, then run:
+
+    tools/http_load.py --concurrency 1 4 8 --duration 10
+
+For each concurrency level, that many clients send GET requests back to back on keep-alive
+connections for --duration seconds. The script reports requests per second, p50/p99 latency
+of successful requests, and how many were answered 503 (workers backed up) or failed outright.
+"""
+
+import argparse
+import http.client
+import threading
+import time
+
+from stats import percentile
+
+
+def client(host, path, timeout, deadline, result):
+    conn = None
+    while time.monotonic() < deadline:
+        if conn is None:
+            conn = http.client.HTTPConnection(host, timeout=timeout)
+        start = time.monotonic()
+        try:
+            conn.request("GET", path, headers={"Accept-Encoding": "gzip"})
+            resp = conn.getresponse()
+            resp.read()
+        except (OSError, http.client.HTTPException):
+            result["errors"] += 1
+            conn.close()
+            conn = None
+            continue
+        elapsed_ms = (time.monotonic() - start) * 1000.0
+        if resp.status == 503:
+            result["rejected"] += 1
+        elif resp.status < 400:
+            result["latencies"].append(elapsed_ms)
+        else:
+            result["errors"] += 1
+        if resp.will_close:
+            conn.close()
+            conn = None
+    if conn is not None:
+        conn.close()
+
+
+def run_level(host, path, clients, duration, timeout):
+    deadline = time.monotonic() + duration
+    results = [{"latencies": [], "rejected": 0, "errors": 0} for _ in range(clients)]
+    threads = [threading.Thread(target=client, args=(host, path, timeout, deadline, r)) for r in results]
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - start
+
+    latencies = [ms for r in results for ms in r["latencies"]]
+    return {
+        "rps": len(latencies) / elapsed,
+        "ok": len(latencies),
+        "rejected": sum(r["rejected"] for r in results),
+        "errors": sum(r["errors"] for r in results),
+        "p50": percentile(latencies, 50) if latencies else float("nan"),
+        "p99": percentile(latencies, 99) if latencies else float("nan"),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.4.1", help="portal address, host[:port]")
+    parser.add_argument("--path", default="/", help="URL to request")
+    parser.add_argument("--concurrency", type=int, nargs="+", default=[1, 4, 8])
+    parser.add_argument("--duration", type=float, default=10, help="seconds per concurrency level")
+    parser.add_argument("--timeout", type=float, default=5, help="per-request timeout in seconds")
+    args = parser.parse_args()
+
+    print("%-8s %8s %7s %7s %9s %9s" % ("clients", "req/s", "ok", "503", "p50 ms", "p99 ms"))
+    for clients in args.concurrency:
+        r = run_level(args.host, args.path, clients, args.duration, args.timeout)
+        print("%-8d %8.1f %7d %7d %9.1f %9.1f%s" % (clients, r["rps"], r["ok"], r["rejected"], r["p50"], r["p99"],
+                                                    "   (%d errors)" % r["errors"] if r["errors"] else ""))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Portal latency benchmark against a device in provisioning mode.
+
+Join the device's SoftAP (or forward its port), reset it, then run:
+
+    tools/portal_bench.py --wait 30 --out bench.json
+
+The script polls until the portal answers GET /. It then times a batch of GET / requests and
+reads the device's own stage times from /metrics. The result is written as JSON along with the
+current git commit and a hash of sdkconfig, so reports from different builds can be compared.
+A /save round trip is timed only when --ssid is given, because it really provisions the device.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+from stats import percentile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+STAGE = re.compile(r'^prov_stage_first_seconds\{stage="([a-z_]+)"\} ([0-9.]+)$', re.M)
+# Device-side stages worth tracking per build; seconds since reset as the device saw them
+REPORTED_STAGES = ("init_start", "nvs_ready", "netif_ready", "wifi_started", "softap_started",
+                   "httpd_started", "ble_started")
+
+
+def fetch(url, timeout):
+    start = time.monotonic()
+    with urllib.request.urlopen(url, timeout=timeout) as resp:
+        body = resp.read()
+    return (time.monotonic() - start) * 1000.0, body
+
+
+def wait_for_portal(base, wait_s, timeout):
+    start = time.monotonic()
+    while True:
+        try:
+            fetch(base + "/", timeout)
+            return (time.monotonic() - start) * 1000.0
+        except (urllib.error.URLError, OSError):
+            if time.monotonic() - start > wait_s:
+                return None
+            time.sleep(0.1)
+
+
+def device_stages(base, timeout):
+    """Stage times from /metrics in ms since reset, or None if /metrics did not answer."""
+    try:
+        _, body = fetch(base + "/metrics", timeout)
+    except (urllib.error.URLError, OSError) as e:
+        print("warning: /metrics unavailable: %s" % e, file=sys.stderr)
+        return None
+    stages = {name: float(sec) for name, sec in STAGE.findall(body.decode(errors="replace"))}
+    return {name: round(stages[name] * 1000.0, 1) for name in REPORTED_STAGES if name in stages}
+
+
+def summary(samples):
+    return {
+        "n": len(samples),
+        "p50_ms": round(percentile(samples, 50), 2),
+        "p90_ms": round(percentile(samples, 90), 2),
+        "p99_ms": round(percentile(samples, 99), 2),
+        "max_ms": round(max(samples), 2),
+    }
+
+
+def build_info():
+    info = {}
+    try:
+        info["commit"] = subprocess.check_output(["git", "-C", ROOT, "rev-parse", "HEAD"],
+                                                 stderr=subprocess.DEVNULL, text=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        info["commit"] = None
+    try:
+        with open(os.path.join(ROOT, "sdkconfig"), "rb") as f:
+            info["sdkconfig_sha256"] = hashlib.sha256(f.read()).hexdigest()
+    except OSError:
+        info["sdkconfig_sha256"] = None
+    return info
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="192.168.4.1", help="portal address, host[:port]")
+    parser.add_argument("--requests", type=int, default=50, help="GET / requests to time")
+    parser.add_argument("--wait", type=float, default=0, help="seconds to wait for the portal to come up")
+    parser.add_argument("--timeout", type=float, default=5, help="per-request timeout in seconds")
+    parser.add_argument("--ssid", help="also time a /save round trip with these credentials")
+    parser.add_argument("--password", default="", help="passphrase for --ssid")
+    parser.add_argument("--out", help="write the JSON report here instead of stdout")
+    args = parser.parse_args()
+
+    base = "http://" + args.host
+    report = {"build": build_info(), "host": args.host}
+
+    first_ms = wait_for_portal(base, args.wait, args.timeout)
+    if first_ms is None:
+        sys.exit("portal at %s did not answer within %.0f s" % (base, args.wait))
+    report["portal_first_answer_ms"] = round(first_ms, 2)
+
+    samples = [fetch(base + "/", args.timeout)[0] for _ in range(args.requests)]
+    report["get_index"] = summary(samples)
+
+    report["device_stages_ms"] = device_stages(base, args.timeout)
+
+    if args.ssid:
+        query = urllib.parse.urlencode({"ssid": args.ssid, "pass": args.password})
+        save_ms, _ = fetch(base + "/save?" + query, args.timeout)
+        report["save_round_trip_ms"] = round(save_ms, 2)
+
+    text = json.dumps(report, indent=2, sort_keys=True)
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()
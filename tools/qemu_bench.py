@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""End-to-end boot and portal benchmark of the real firmware under Espressif's QEMU.
+
+Needs an ESP-IDF environment (idf.py, esptool.py) and Espressif's qemu-system-xtensa on PATH:
+
+    tools/qemu_bench.py --out qemu_bench.json
+
+The image is built into build_qemu with sdkconfig.qemu laid over the project sdkconfig and
+WIFI_PROV_QEMU_ETH=1, so the portal is served over QEMU's open_eth NIC instead of the SoftAP.
+Each run boots a blank copy of the flash, so the device always starts in provisioning mode, and
+forwards the portal to a local port. The JSON report holds:
+
+  boot_to_app_main_ms     device log time of app_main's first line (ms since reset)
+  nvs_init_ms             nvs_flash_init() as the device timed it (nvs_ready - init_start)
+  portal_first_answer_ms  QEMU start until GET / answers
+  get_index               a batch of GET / timings
+  save_round_trip_ms      one /save; the live apply then restarts the device, so it runs last
+
+QEMU is not cycle accurate. Compare reports between commits; they are not device figures.
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib.error
+import urllib.parse
+
+from portal_bench import ROOT, build_info, device_stages, fetch, summary, wait_for_portal
+
+ANSI = re.compile(r'\x1b\[[0-9;]*m')
+APP_MAIN = re.compile(r'^I \((\d+)\) MAIN: ')
+FLASH_SIZE = re.compile(r'^CONFIG_ESPTOOLPY_FLASHSIZE="([0-9]+MB)"$', re.M)
+
+
+def build(build_dir):
+    # Regenerate the config every run so changes to the project sdkconfig reach this build
+    sdkconfig = os.path.join(build_dir, "sdkconfig")
+    if os.path.exists(sdkconfig):
+        os.remove(sdkconfig)
+    subprocess.check_call(["idf.py", "-B", build_dir, "-DSDKCONFIG=" + sdkconfig,
+                           "-DSDKCONFIG_DEFAULTS=sdkconfig;sdkconfig.qemu", "-DWIFI_PROV_QEMU_ETH=1", "build"],
+                          cwd=ROOT)
+
+
+def make_flash(build_dir, path):
+    with open(os.path.join(build_dir, "sdkconfig")) as f:
+        m = FLASH_SIZE.search(f.read())
+    # QEMU wants an image of the whole flash chip; the unwritten rest is erased (0xff)
+    subprocess.check_call(["esptool.py", "--chip", "esp32", "merge_bin", "--fill-flash-size",
+                           m.group(1) if m else "4MB", "-o", path, "@flash_args"],
+                          cwd=build_dir, stdout=subprocess.DEVNULL)
+
+
+class Serial(threading.Thread):
+    """Collects QEMU's console and notes when app_main logs its first line."""
+
+    def __init__(self, proc, start):
+        super().__init__(daemon=True)
+        self.proc = proc
+        self.start_time = start
+        self.lines = []
+        self.app_main = threading.Event()
+        self.app_main_device_ms = None
+        self.app_main_host_ms = None
+
+    def run(self):
+        for raw in self.proc.stdout:
+            line = ANSI.sub("", raw.decode(errors="replace")).rstrip()
+            self.lines.append(line)
+            m = APP_MAIN.match(line)
+            if m and not self.app_main.is_set():
+                self.app_main_device_ms = int(m.group(1))
+                self.app_main_host_ms = (time.monotonic() - self.start_time) * 1000.0
+                self.app_main.set()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--build-dir", default=os.path.join(ROOT, "build_qemu"))
+    parser.add_argument("--no-build", action="store_true", help="use the image already in --build-dir")
+    parser.add_argument("--qemu", default="qemu-system-xtensa", help="Espressif QEMU binary")
+    parser.add_argument("--port", type=int, default=8080, help="local port the portal is forwarded to")
+    parser.add_argument("--boot-timeout", type=float, default=60, help="seconds to wait for the portal")
+    parser.add_argument("--requests", type=int, default=50, help="GET / requests to time")
+    parser.add_argument("--timeout", type=float, default=5, help="per-request timeout in seconds")
+    parser.add_argument("--ssid", default="qemu-bench", help="credentials sent to /save")
+    parser.add_argument("--password", default="qemu-bench-pass")
+    parser.add_argument("--log", help="also write the QEMU console here")
+    parser.add_argument("--out", help="write the JSON report here instead of stdout")
+    args = parser.parse_args()
+
+    build_dir = os.path.abspath(args.build_dir)
+    if not args.no_build:
+        build(build_dir)
+    if shutil.which(args.qemu) is None:
+        sys.exit("%s not found; install Espressif's QEMU (idf_tools.py install qemu-xtensa)" % args.qemu)
+
+    base = "http://127.0.0.1:%d" % args.port
+    report = {"build": build_info(), "host": "qemu"}
+    report["build"]["flags"] = ["WIFI_PROV_QEMU_ETH=1", "sdkconfig.qemu"]
+
+    with tempfile.TemporaryDirectory() as tmp:
+        flash = os.path.join(tmp, "flash.bin")
+        make_flash(build_dir, flash)
+        cmd = [args.qemu, "-nographic", "-machine", "esp32",
+               "-drive", "file=%s,if=mtd,format=raw" % flash,
+               "-nic", "user,model=open_eth,id=lo0,hostfwd=tcp:127.0.0.1:%d-:80" % args.port]
+        start = time.monotonic()
+        proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        serial = Serial(proc, start)
+        serial.start()
+        try:
+            if not serial.app_main.wait(args.boot_timeout):
+                sys.exit("app_main did not log within %.0f s" % args.boot_timeout)
+            report["boot_to_app_main_ms"] = serial.app_main_device_ms
+            report["qemu_start_to_app_main_ms"] = round(serial.app_main_host_ms, 2)
+
+            remaining = args.boot_timeout - (time.monotonic() - start)
+            if wait_for_portal(base, max(remaining, 0), args.timeout) is None:
+                sys.exit("portal at %s did not answer within %.0f s" % (base, args.boot_timeout))
+            report["portal_first_answer_ms"] = round((time.monotonic() - start) * 1000.0, 2)
+
+            samples = [fetch(base + "/", args.timeout)[0] for _ in range(args.requests)]
+            report["get_index"] = summary(samples)
+
+            stages = device_stages(base, args.timeout)
+            report["device_stages_ms"] = stages
+            if stages and "init_start" in stages and "nvs_ready" in stages:
+                report["nvs_init_ms"] = round(stages["nvs_ready"] - stages["init_start"], 1)
+            else:
+                report["nvs_init_ms"] = None
+
+            query = urllib.parse.urlencode({"ssid": args.ssid, "pass": args.password})
+            try:
+                save_ms, _ = fetch(base + "/save?" + query, args.timeout)
+                report["save_round_trip_ms"] = round(save_ms, 2)
+            except (urllib.error.URLError, OSError) as e:
+                report["save_round_trip_ms"] = None
+                print("warning: /save failed: %s" % e, file=sys.stderr)
+        finally:
+            proc.terminate()
+            try:
+                proc.wait(5)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+            serial.join(1)
+            if args.log:
+                with open(args.log, "w") as f:
+                    f.write("\n".join(serial.lines) + "\n")
+
+    text = json.dumps(report, indent=2, sort_keys=True)
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,10 @@
+"""Shared helpers for the measurement scripts in this directory."""
+
+import math
+
+
+def percentile(values, pct):
+    """Nearest-rank percentile: the smallest value with at least pct% of the samples at or below it."""
+    values = sorted(values)
+    rank = max(0, min(len(values) - 1, math.ceil(pct / 100.0 * len(values)) - 1))
+    return values[rank]
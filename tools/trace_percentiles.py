@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Per-stage boot latency percentiles from TRACE dumps in device logs.
+
+Each device prints its boot timeline once, after the first connectivity probe:
+
+    I (5123) TRACE: begin,14
+    I (5123) TRACE: nvs_ready,312045,0
+    ...
+    I (5130) TRACE: end
+
+Pass any number of captured logs (one per device or boot, or concatenated). For every stage the
+script reports the time since init_start and the time since the previous stage of the same boot,
+as p50/p90/p99 across all boots.
+
+    tools/trace_percentiles.py logs/*.txt
+"""
+
+import argparse
+import re
+import sys
+
+from stats import percentile
+
+LINE = re.compile(r"TRACE: (begin|end|([a-z_]+),(-?\d+),(\d+))")
+
+
+def parse_dumps(paths):
+    dumps = []
+    current = None
+    for path in paths:
+        with open(path, errors="replace") as f:
+            for line in f:
+                m = LINE.search(line)
+                if not m:
+                    continue
+                if m.group(1) == "begin":
+                    current = []
+                elif m.group(1) == "end":
+                    if current:
+                        dumps.append(current)
+                    current = None
+                elif current is not None:
+                    current.append((m.group(2), int(m.group(3)), int(m.group(4))))
+    return dumps
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("logs", nargs="+", help="serial logs containing TRACE dumps")
+    parser.add_argument("--origin", default="init_start", help="stage the totals are measured from")
+    args = parser.parse_args()
+
+    dumps = parse_dumps(args.logs)
+    if not dumps:
+        sys.exit("no TRACE dumps found")
+
+    since_origin = {}
+    since_prev = {}
+    order = []
+    for entries in dumps:
+        # First occurrence of each stage only; later ones belong to reconnects, not boot
+        first = {}
+        for stage, t_us, _ in entries:
+            first.setdefault(stage, t_us)
+        if args.origin not in first:
+            continue
+        origin = first[args.origin]
+        prev = None
+        for stage, t_us in sorted(first.items(), key=lambda kv: kv[1]):
+            if stage not in order:
+                order.append(stage)
+            since_origin.setdefault(stage, []).append((t_us - origin) / 1000.0)
+            if prev is not None:
+                since_prev.setdefault(stage, []).append((t_us - prev) / 1000.0)
+            prev = t_us
+
+    print("%d boot(s), times in ms" % len(dumps))
+    print("%-18s %5s  %9s %9s %9s   %9s %9s %9s" %
+          ("stage", "n", "p50", "p90", "p99", "step p50", "step p90", "step p99"))
+    for stage in order:
+        total = since_origin[stage]
+        step = since_prev.get(stage)
+        row = "%-18s %5d  %9.1f %9.1f %9.1f" % (stage, len(total), percentile(total, 50),
+                                               percentile(total, 90), percentile(total, 99))
+        if step:
+            row += "   %9.1f %9.1f %9.1f" % (percentile(step, 50), percentile(step, 90), percentile(step, 99))
+        print(row)
+
+
+if __name__ == "__main__":
+    main()